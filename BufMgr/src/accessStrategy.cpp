@@ -0,0 +1,25 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "accessStrategy.h"
+
+namespace badgerdb {
+
+const FrameId BufferAccessStrategy::NO_FRAME;
+
+BufferAccessStrategy::BufferAccessStrategy(const StrategyType strategyType, const std::uint32_t ringFrames)
+	: type(strategyType), current(0)
+{
+	std::uint32_t frames = ringFrames;
+	if(frames == 0)
+	{
+		frames = type == StrategyType::BULKREAD ? DEFAULT_BULKREAD_FRAMES : DEFAULT_BULKWRITE_FRAMES;
+	}
+	ring.assign(frames, NO_FRAME);
+}
+
+}
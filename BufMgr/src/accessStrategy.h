@@ -0,0 +1,97 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Kinds of bulk access an access strategy is made for
+*/
+enum class StrategyType {
+	/**
+   * Large sequential reads, e.g. a full file scan. Dirty ring frames are left to the main pool instead of
+   * being written back by the scan.
+	 */
+  BULKREAD,
+
+	/**
+   * Bulk loads writing many pages. Dirty ring frames are written back and reused.
+	 */
+  BULKWRITE
+};
+
+/**
+* @brief Confines the page reads of one bulk operation to a small private ring of frames.
+*
+* Pages missed through a strategy are read into the frames of its ring, which are then recycled among
+* themselves instead of taking new frames from the replacement policy. Pages read this way are not reported
+* to the replacement policy as referenced, so a scan neither evicts nor outranks the hot working set. A ring
+* frame that is accessed without the strategy in the meantime is given up to the main pool.
+*
+* A strategy belongs to one operation and must not be used by several threads at once.
+*/
+class BufferAccessStrategy
+{
+	friend class BufMgr;
+
+ private:
+	/**
+   * Kind of access
+	 */
+  StrategyType type;
+
+	/**
+   * Frames of the ring, NO_FRAME for slots not filled yet
+	 */
+  std::vector<FrameId> ring;
+
+	/**
+   * Slot of the ring used by the next miss
+	 */
+  std::size_t current;
+
+ public:
+	/**
+   * Marks ring slots that have no frame yet
+	 */
+  static const FrameId NO_FRAME = ~(FrameId)0;
+
+	/**
+   * Ring size used for BULKREAD if none is given, 256 KiB worth of pages
+	 */
+  static const std::uint32_t DEFAULT_BULKREAD_FRAMES = 32;
+
+	/**
+   * Ring size used for BULKWRITE if none is given. Larger, so pages written back are not immediately needed
+   * again.
+	 */
+  static const std::uint32_t DEFAULT_BULKWRITE_FRAMES = 128;
+
+	/**
+   * Constructor of BufferAccessStrategy class. The buffer manager never lets a ring grow past an eighth of
+   * its pool.
+	 *
+	 * @param strategyType	Kind of access
+	 * @param ringFrames		Number of frames in the ring, the default for the type if 0
+	 */
+  BufferAccessStrategy(const StrategyType strategyType, const std::uint32_t ringFrames = 0);
+
+	/**
+   * Returns the kind of access
+	 */
+  StrategyType getType() const
+	{
+		return type;
+	}
+};
+
+}
@@ -0,0 +1,200 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "arcPolicy.h"
+#include "pageTable.h"
+
+namespace badgerdb {
+
+ArcPolicy::ArcPolicy(const std::uint32_t frames)
+	: numFrames(frames), p(0)
+{
+	frameList = new FrameList[frames];
+	prev = new FrameId[frames];
+	next = new FrameId[frames];
+	for (int i = 0; i < 3; i++)
+	{
+		lists[i].head = lists[i].tail = frames;
+		lists[i].size = 0;
+	}
+	for (FrameId i = 0; i < frames; i++)
+	{
+		frameList[i] = FREE_LIST;
+		pushMru(FREE_LIST, i);
+	}
+}
+
+ArcPolicy::~ArcPolicy()
+{
+	delete [] frameList;
+	delete [] prev;
+	delete [] next;
+}
+
+void ArcPolicy::unlink(const FrameId frameNo)
+{
+	ListHead& list = lists[frameList[frameNo]];
+	if(prev[frameNo] != numFrames)
+		next[prev[frameNo]] = next[frameNo];
+	else
+		list.head = next[frameNo];
+	if(next[frameNo] != numFrames)
+		prev[next[frameNo]] = prev[frameNo];
+	else
+		list.tail = prev[frameNo];
+	list.size--;
+}
+
+void ArcPolicy::pushMru(const FrameList list, const FrameId frameNo)
+{
+	ListHead& head = lists[list];
+	frameList[frameNo] = list;
+	prev[frameNo] = head.tail;
+	next[frameNo] = numFrames;
+	if(head.tail != numFrames)
+		next[head.tail] = frameNo;
+	else
+		head.head = frameNo;
+	head.tail = frameNo;
+	head.size++;
+}
+
+void ArcPolicy::dropGhost(const GhostList list)
+{
+	ghostIndex.erase(ghosts[list].front());
+	ghosts[list].pop_front();
+}
+
+bool ArcPolicy::lruEvictable(const FrameList list, FrameId& frameNo, const EvictablePredicate& evictable)
+{
+	for (FrameId i = lists[list].head; i != numFrames; i = next[i])
+	{
+		if(evictable(i))
+		{
+			frameNo = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ArcPolicy::recordAccess(const FrameId frameNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frameNo);
+	pushMru(T2_LIST, frameNo);
+}
+
+void ArcPolicy::recordLoad(const FrameId frameNo, const File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frameNo);
+	std::uint64_t key = PageTable::packKey(file, pageNo);
+	std::unordered_map<std::uint64_t, GhostEntry>::iterator ghost = ghostIndex.find(key);
+	if(ghost == ghostIndex.end())
+	{
+		//A new page, make room for its ghost to come
+		if(lists[T1_LIST].size + ghosts[B1_LIST].size() >= numFrames && !ghosts[B1_LIST].empty())
+		{
+			dropGhost(B1_LIST);
+		}
+		else if(lists[T1_LIST].size + lists[T2_LIST].size + ghostIndex.size() >= 2 * numFrames
+			&& !ghosts[B2_LIST].empty())
+		{
+			dropGhost(B2_LIST);
+		}
+		pushMru(T1_LIST, frameNo);
+		return;
+	}
+
+	//A ghost hit tells which list should have been larger
+	std::uint32_t b1 = ghosts[B1_LIST].size();
+	std::uint32_t b2 = ghosts[B2_LIST].size();
+	if(ghost->second.list == B1_LIST)
+	{
+		p = std::min(numFrames, p + std::max<std::uint32_t>(b2 / b1, 1));
+	}
+	else
+	{
+		std::uint32_t delta = std::max<std::uint32_t>(b1 / b2, 1);
+		p = p > delta ? p - delta : 0;
+	}
+	ghosts[ghost->second.list].erase(ghost->second.pos);
+	ghostIndex.erase(ghost);
+	pushMru(T2_LIST, frameNo);
+}
+
+void ArcPolicy::recordUnpin(const FrameId frameNo)
+{
+}
+
+void ArcPolicy::recordEviction(const FrameId frameNo, const File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	FrameList list = frameList[frameNo];
+	unlink(frameNo);
+	pushMru(FREE_LIST, frameNo);
+	if(list == FREE_LIST)
+	{
+		return;
+	}
+	GhostList ghostList = list == T1_LIST ? B1_LIST : B2_LIST;
+	std::uint64_t key = PageTable::packKey(file, pageNo);
+	std::unordered_map<std::uint64_t, GhostEntry>::iterator ghost = ghostIndex.find(key);
+	if(ghost != ghostIndex.end())
+	{
+		ghosts[ghost->second.list].erase(ghost->second.pos);
+		ghostIndex.erase(ghost);
+	}
+	GhostEntry entry;
+	entry.list = ghostList;
+	entry.pos = ghosts[ghostList].insert(ghosts[ghostList].end(), key);
+	ghostIndex[key] = entry;
+	//Loads that fail never trim the ghosts, so cap them at c here too
+	if(ghostIndex.size() > numFrames)
+	{
+		dropGhost(ghosts[B1_LIST].size() > ghosts[B2_LIST].size() ? B1_LIST : B2_LIST);
+	}
+}
+
+void ArcPolicy::recordFree(const FrameId frameNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	unlink(frameNo);
+	pushMru(FREE_LIST, frameNo);
+}
+
+bool ArcPolicy::pickVictim(FrameId& frameNo, const EvictablePredicate& evictable)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if(lruEvictable(FREE_LIST, frameNo, evictable))
+	{
+		return true;
+	}
+	FrameList first = lists[T1_LIST].size > p ? T1_LIST : T2_LIST;
+	FrameList second = first == T1_LIST ? T2_LIST : T1_LIST;
+	return lruEvictable(first, frameNo, evictable) || lruEvictable(second, frameNo, evictable);
+}
+
+void ArcPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	FrameList first = lists[T1_LIST].size > p ? T1_LIST : T2_LIST;
+	FrameList second = first == T1_LIST ? T2_LIST : T1_LIST;
+	std::uint32_t listed = 0;
+	for (FrameId i = lists[first].head; i != numFrames && listed < count; i = next[i], listed++)
+	{
+		frames.push_back(i);
+	}
+	for (FrameId i = lists[second].head; i != numFrames && listed < count; i = next[i], listed++)
+	{
+		frames.push_back(i);
+	}
+}
+
+}
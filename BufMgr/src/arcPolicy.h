@@ -0,0 +1,172 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "replacementPolicy.h"
+
+namespace badgerdb {
+
+/**
+* @brief The Adaptive Replacement Cache policy (Megiddo and Modha).
+*
+* Resident pages are split between T1, pages referenced once since they were read in, and T2, pages
+* referenced again. The ghost lists B1 and B2 remember the keys of pages recently evicted from T1 and T2.
+* A miss on a B1 ghost means T1 was too small, so the target size p of T1 grows; a miss on a B2 ghost
+* shrinks it. Victims come from the LRU end of T1 while T1 is above its target, from T2 otherwise.
+*
+* T1 and T2 are intrusive lists threaded through per-frame arrays, so only the ghost entries cost extra
+* memory. Every hook runs in constant time, except that victim selection skips over pinned frames.
+*
+* The buffer manager asks for a victim before it reads the missing page, so p adapts right after the
+* victim is chosen instead of right before.
+*/
+class ArcPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+	 * Lists a frame can be on
+	 */
+  enum FrameList { FREE_LIST = 0, T1_LIST = 1, T2_LIST = 2 };
+
+	/**
+	 * Ghost lists
+	 */
+  enum GhostList { B1_LIST = 0, B2_LIST = 1 };
+
+	/**
+	 * Ends and length of one intrusive frame list, LRU at the head
+	 */
+  struct ListHead
+	{
+	  FrameId head;
+	  FrameId tail;
+	  std::uint32_t size;
+	};
+
+	/**
+	 * Position of a ghost entry
+	 */
+  struct GhostEntry
+	{
+	  GhostList list;
+	  std::list<std::uint64_t>::iterator pos;
+	};
+
+	/**
+   * Number of frames in the buffer pool, c in the paper
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Protects all members below
+	 */
+  std::mutex latch;
+
+	/**
+   * Target size of T1
+	 */
+  std::uint32_t p;
+
+	/**
+   * Free frames, T1 and T2, indexed by FrameList
+	 */
+  ListHead lists[3];
+
+	/**
+   * List every frame is on
+	 */
+  FrameList* frameList;
+
+	/**
+   * Previous frame in the list, towards the LRU end, numFrames if none
+	 */
+  FrameId* prev;
+
+	/**
+   * Next frame in the list, towards the MRU end, numFrames if none
+	 */
+  FrameId* next;
+
+	/**
+   * Keys (PageTable::packKey()) of pages evicted from T1 and T2, LRU at the front, indexed by GhostList
+	 */
+  std::list<std::uint64_t> ghosts[2];
+
+	/**
+   * Ghost entries by key
+	 */
+  std::unordered_map<std::uint64_t, GhostEntry> ghostIndex;
+
+	/**
+	 * Unlinks frameNo from its list.
+	 */
+  void unlink(const FrameId frameNo);
+
+	/**
+	 * Links frameNo in at the MRU end of list.
+	 */
+  void pushMru(const FrameList list, const FrameId frameNo);
+
+	/**
+	 * Forgets the LRU entry of a ghost list.
+	 */
+  void dropGhost(const GhostList list);
+
+	/**
+	 * Returns the unpinned frame closest to the LRU end of list.
+	 */
+  bool lruEvictable(const FrameList list, FrameId& frameNo, const EvictablePredicate& evictable);
+
+ public:
+	/**
+   * Constructor of ArcPolicy class
+	 *
+	 * @param frames	Number of frames in the buffer pool
+	 */
+  ArcPolicy(const std::uint32_t frames);
+
+	/**
+   * Destructor of ArcPolicy class
+	 */
+  ~ArcPolicy();
+
+	/**
+	 * Moves the frame to the MRU end of T2.
+	 */
+  void recordAccess(const FrameId frameNo);
+
+	/**
+	 * Adapts p if the page has a ghost entry and moves the frame to T2 in that case, to T1 otherwise.
+	 */
+  void recordLoad(const FrameId frameNo, const File* file, const PageId pageNo);
+
+  void recordUnpin(const FrameId frameNo);
+
+	/**
+	 * Leaves a ghost of the page in B1 or B2 and marks the frame free.
+	 */
+  void recordEviction(const FrameId frameNo, const File* file, const PageId pageNo);
+
+  void recordFree(const FrameId frameNo);
+
+	/**
+	 * Returns a free frame if there is one, else the LRU unpinned frame of T1 if T1 exceeds its target
+	 * size, else that of T2.
+	 */
+  bool pickVictim(FrameId& frameNo, const EvictablePredicate& evictable);
+
+	/**
+	 * Returns frames from the LRU end of the list victims currently come from, then of the other list.
+	 */
+  void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count);
+};
+
+}
@@ -0,0 +1,121 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ *
+ * File description - Benchmark of ClockPolicy with a single reference bit (CLOCK) against saturating usage
+ * counts (GCLOCK). A simulated buffer pool replays page reference traces through the policy hooks the
+ * buffer manager calls, and reports the hit ratio and the time per reference of each setting.
+ * Usage: clockBench [frames]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include "clockPolicy.h"
+
+using namespace badgerdb;
+
+static const std::uint32_t MAX_COUNTS[] = {1, 2, 3, 5, 8};
+
+static bool anyFrame(const void*, const FrameId)
+{
+	return true;
+}
+
+static double nsPerOp(std::chrono::steady_clock::time_point start, std::size_t ops)
+{
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / ops;
+}
+
+/**
+ * Hot pages picked at random, interleaved with a sequential scan over pages read once each
+ */
+static void scanTrace(std::vector<PageId>& trace, std::uint32_t frames, std::size_t length, int hotPercent)
+{
+	const std::uint32_t hotPages = frames / 2;
+	PageId scanPage = hotPages;
+	srandom(frames);
+	for (std::size_t i = 0; i < length; i++) {
+		if ((int)(random() % 100) < hotPercent)
+			trace[i] = random() % hotPages;
+		else
+			trace[i] = scanPage++;
+	}
+}
+
+/**
+ * 80 percent of the references go to 20 percent of the pages, recursively, over pages worth four pools
+ */
+static void skewedTrace(std::vector<PageId>& trace, std::uint32_t frames, std::size_t length)
+{
+	const std::uint32_t pages = 4 * frames;
+	srandom(frames + 1);
+	for (std::size_t i = 0; i < length; i++) {
+		std::uint32_t range = pages;
+		while (range > 1 && random() % 100 < 80)
+			range = range / 5 > 0 ? range / 5 : 1;
+		trace[i] = random() % range;
+	}
+}
+
+static void run(const char* name, std::uint32_t frames, const std::vector<PageId>& trace)
+{
+	for (std::size_t m = 0; m < sizeof(MAX_COUNTS) / sizeof(MAX_COUNTS[0]); m++) {
+		ClockPolicy policy(frames, MAX_COUNTS[m]);
+		std::unordered_map<PageId, FrameId> resident;
+		std::vector<PageId> framePage(frames);
+		resident.reserve(2 * frames);
+		ReplacementPolicy::EvictablePredicate evictable = {&anyFrame, NULL};
+		FrameId used = 0;
+		std::size_t hits = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < trace.size(); i++) {
+			std::unordered_map<PageId, FrameId>::iterator it = resident.find(trace[i]);
+			if (it != resident.end()) {
+				policy.recordAccess(it->second);
+				hits++;
+				continue;
+			}
+			FrameId frameNo;
+			if (used < frames) {
+				frameNo = used++;
+			}
+			else {
+				if (!policy.pickVictim(frameNo, evictable)) {
+					fprintf(stderr, "%s: no victim\n", name);
+					exit(1);
+				}
+				resident.erase(framePage[frameNo]);
+				policy.recordEviction(frameNo, NULL, framePage[frameNo]);
+			}
+			framePage[frameNo] = trace[i];
+			resident[trace[i]] = frameNo;
+			policy.recordLoad(frameNo, NULL, trace[i]);
+		}
+		double ns = nsPerOp(start, trace.size());
+
+		printf("%-12s %10u %10u %10.2f %10.1f\n", name, frames, MAX_COUNTS[m],
+					 100.0 * hits / trace.size(), ns);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	std::vector<PageId> trace(100 * (std::size_t)frames);
+
+	printf("%-12s %10s %10s %10s %10s\n", "trace", "frames", "max usage", "hit %", "ns/ref");
+	scanTrace(trace, frames, trace.size(), 50);
+	run("hot+scan", frames, trace);
+	scanTrace(trace, frames, trace.size(), 80);
+	run("hot+scan/80", frames, trace);
+	skewedTrace(trace, frames, trace.size());
+	run("skewed", frames, trace);
+	return 0;
+}
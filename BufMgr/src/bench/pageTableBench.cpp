@@ -0,0 +1,121 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ *
+ * File description - Microbenchmark of the chained BufHashTbl against the open-addressing PageTable for
+ * the operations the buffer manager issues: inserts, hits, misses and the remove/insert pairs of evictions.
+ * Usage: pageTableBench [max frames]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bufHashTbl.h"
+#include "pageTable.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+static const int NUM_FILES = 4;
+
+struct Key {
+	File* file;
+	PageId pageNo;
+};
+
+static double nsPerOp(std::chrono::steady_clock::time_point start, std::size_t ops)
+{
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / ops;
+}
+
+template <class Table>
+static void run(const char* name, Table& table, const std::vector<Key>& resident,
+								const std::vector<Key>& probes, const std::vector<Key>& missing)
+{
+	const std::size_t n = resident.size();
+	FrameId frameNo;
+	std::size_t found = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < n; i++)
+		table.insert(resident[i].file, resident[i].pageNo, i);
+	double insertNs = nsPerOp(start, n);
+
+	//Probe in an order unrelated to the inserts, so neither table gets to
+	//walk its memory in allocation order
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < n; i++)
+		found += table.tryLookup(probes[i].file, probes[i].pageNo, frameNo);
+	double hitNs = nsPerOp(start, n);
+
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < n; i++)
+		found += table.tryLookup(missing[i].file, missing[i].pageNo, frameNo);
+	double missNs = nsPerOp(start, n);
+
+	//Each eviction drops a resident page and maps a new one to its frame
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < n; i++) {
+		table.remove(resident[i].file, resident[i].pageNo);
+		table.insert(missing[i].file, missing[i].pageNo, i);
+	}
+	double evictNs = nsPerOp(start, n);
+
+	if (found != n) {
+		std::cerr << name << ": expected " << n << " hits, found " << found << "\n";
+		exit(1);
+	}
+	printf("%-12s %10zu %10.1f %10.1f %10.1f %10.1f\n", name, n, insertNs, hitNs, missNs, evictNs);
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t maxFrames = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+	const std::string filename = "pageTableBench.db";
+	try {
+		File::remove(filename);
+	}
+	catch (FileNotFoundException&) {
+	}
+	{
+		File created = File::create(filename);
+		std::vector<File> files(NUM_FILES, created);
+
+		printf("%-12s %10s %10s %10s %10s %10s\n", "table", "frames", "insert", "hit", "miss", "evict");
+		printf("%-12s %10s %10s %10s %10s %10s\n", "", "", "ns/op", "ns/op", "ns/op", "ns/op");
+		for (std::size_t frames = 10000; frames <= maxFrames; frames *= 10) {
+			//Resident pages are spread over a few files at random page numbers;
+			//missing pages use page numbers no resident page has
+			std::vector<Key> resident(frames), missing(frames);
+			srandom(frames);
+			for (std::size_t i = 0; i < frames; i++) {
+				resident[i].file = &files[i % NUM_FILES];
+				resident[i].pageNo = 2 * i + 1;
+				missing[i].file = &files[i % NUM_FILES];
+				missing[i].pageNo = 2 * i + 2;
+			}
+			std::random_shuffle(resident.begin(), resident.end());
+			std::random_shuffle(missing.begin(), missing.end());
+			std::vector<Key> probes(resident);
+			std::random_shuffle(probes.begin(), probes.end());
+
+			{
+				BufHashTbl chained((int)(frames * 1.2) + 1);
+				run("BufHashTbl", chained, resident, probes, missing);
+			}
+			{
+				PageTable open(frames);
+				run("PageTable", open, resident, probes, missing);
+			}
+		}
+	}
+	File::remove(filename);
+	return 0;
+}
@@ -15,12 +15,16 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+std::size_t BufHashTbl::hashKey(const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  unsigned int tmp;
+  tmp = (unsigned int)(long)file;  // cast of pointer to the file object to an integer
+  return tmp + pageNo;
+}
+
+int BufHashTbl::hash(const File* file, const PageId pageNo) const
+{
+  return hashKey(file, pageNo) % HTSIZE;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
@@ -68,6 +72,12 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) const
 {
   int index = hash(file, pageNo);
   hashBucket* tmpBuc = ht[index];
@@ -75,12 +85,12 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
+      return true;
     }
     tmpBuc = tmpBuc->next;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  return false;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
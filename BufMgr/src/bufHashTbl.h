@@ -61,10 +61,19 @@ class BufHashTbl
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const File* file, const PageId pageNo) const;
 
  public:
 	/**
+	 * returns the hash of (file, pageNo) before it is reduced to a bucket index
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Hash value.
+	 */
+  static std::size_t hashKey(const File* file, const PageId pageNo);
+
+	/**
    * Constructor of BufHashTbl class
 	 */
 	BufHashTbl(const int htSize);  // constructor
@@ -96,6 +105,16 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool without throwing on a miss.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the page is found
+	 * @return 				True if the page entry is in the hash table
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) const;
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
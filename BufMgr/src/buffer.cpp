@@ -9,244 +9,1897 @@
  * cache at any instant and various functions that bring pages in and out of memory
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <memory>
 #include <iostream>
+#include <new>
+#include <sys/mman.h>
 #include "buffer.h"
+#include "clockPolicy.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/file_io_exception.h"
 using namespace std;
 namespace badgerdb {
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+BufMgr::BufMgr(std::uint32_t bufs, std::uint32_t partitions, ReplacementPolicy* replacement)
+	: numBufs(bufs), numPartitions(partitions > 0 ? partitions : 1),
+		policy(replacement ? replacement : new ClockPolicy(bufs)), sketch(NULL), admissionWindow(NULL),
+		ioEngine(NULL), ioQueueDepth(0), nextUnusedFrame(0), evictorStop(false), cleanerStop(false),
+		cleanerCursor(0), readAheadEnabled(false), frameReleases(0), allocWaiters(0), prefaultStop(false) {
 
-  //A array holding information about each buffer frame
-	bufDescTable = new BufDesc[bufs];
-
-  for (FrameId i = 0; i < bufs; i++)
-  {
-    //Set the valid bit to false initially
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
-  }
+  //A array holding information about each buffer frame. Zero is the state of
+  //a frame never used (unpinned, not valid, holding no page), and calloc()
+  //leaves large arrays to pages the kernel zeroes on first touch
+	bufDescTable = static_cast<BufDesc*>(std::calloc(bufs, sizeof(BufDesc)));
+	frameState = static_cast<std::atomic<std::uint64_t>*>(std::calloc(bufs, sizeof(std::atomic<std::uint64_t>)));
+	if(bufDescTable == NULL || frameState == NULL)
+	{
+		std::free(bufDescTable);
+		std::free(frameState);
+		throw std::bad_alloc();
+	}
 
   //An array of pages brought in memory from the disk
   //correspondence b/w bufPool and bufDescTable shows
-  //what page is pinned to which frame
-  bufPool = new Page[bufs];
-  cout << "Creating a buffer pool of " << numBufs << " frames" <<endl;
-	int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  //what page is pinned to which frame. Frames are left untouched here; each
+  //one is overwritten by the first page read or allocated into it, so memory
+  //is only faulted in as the pool fills up
+  mapArena();
+	//Pages do not spread over the partitions perfectly evenly, so size each
+	//one for twice its share of the frames
+	std::uint32_t htsize = 2 * (bufs / numPartitions) + 16;
+	hashPartitions = new BufHashPartition[numPartitions];
+	for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+		hashPartitions[i].table = new PageTable (htsize);  // allocate the buffer hash table
+	}
 
-  clockHand = bufs - 1;
+	//Every frame starts out free, handed out from frame 0 up by nextUnusedFrame
+	numFree = bufs;
+	evictable.test = &BufMgr::frameEvictable;
+	evictable.context = frameState;
+	prefetchEvictable.test = &BufMgr::framePrefetchEvictable;
+	prefetchEvictable.context = frameState;
+	policy->attachFrameStates(frameState);
 }
 
 
 BufMgr::~BufMgr() {
-	for(uint32_t i = 0; i< numBufs; i++)
+	//Lets every asynchronous read finish first
+	delete ioEngine;
+	prefaultStop = true;
+	if(prefaulter.joinable())
+	{
+		prefaulter.join();
+	}
+	stopEvictor();
+	stopCleaner();
+	//Write every dirty page back, through the File object it was read with,
+	//file by file, sorted and in runs
+	std::unordered_map<File*, std::vector<const Page*> > dirtyPages;
+	for (FrameId i = 0; i < numBufs; i++)
 	{
-		BufDesc page = bufDescTable[i];
-		if(page.valid && page.dirty)
+		std::uint64_t state = frameState[i];
+		if((state & FrameState::VALID) && (state & FrameState::DIRTY))
 		{
-			page.file->writePage(bufPool[page.frameNo]);
+			dirtyPages[bufDescTable[i].file].push_back(&bufPool[i]);
 		}
 	}
-	delete [] bufPool;
-	delete [] bufDescTable;
-	delete hashTable;
+	std::unordered_map<File*, std::vector<const Page*> >::const_iterator fileEntry;
+	for(fileEntry = dirtyPages.begin(); fileEntry != dirtyPages.end(); ++fileEntry)
+	{
+		fileEntry->first->writePages(fileEntry->second);
+	}
+	//Pages own no memory, so there is nothing to destroy
+	munmap(bufPool, arenaBytes);
+	std::free(bufDescTable);
+	std::free(frameState);
+	for (std::uint32_t i = 0; i < numPartitions; i++)
+	{
+		delete hashPartitions[i].table;
+	}
+	delete [] hashPartitions;
+	delete policy;
+	delete sketch;
+	delete admissionWindow;
 }
 
-//Move the hand of the clock to the next frame
-void BufMgr::advanceClock()
+bool BufMgr::frameEvictable(const void* context, const FrameId frameNo)
 {
-  //current index % bufs - 1
-  clockHand = (clockHand + 1)%numBufs;
+	//Only a hint, claimFrame() checks again
+	std::uint64_t state = static_cast<const std::atomic<std::uint64_t>*>(context)[frameNo].load(std::memory_order_relaxed);
+	return FrameState::pinCount(state) == 0 && !(state & (FrameState::IN_FREE_LIST | FrameState::WRITING));
 }
 
-//Will try to return an empty frame from the memory pool,
-void BufMgr::allocBuf(FrameId & frame)
+bool BufMgr::framePrefetchEvictable(const void* context, const FrameId frameNo)
 {
-  //Keep looking for an empty frame, if after a sweep, all pages in memory
-	//are pinned, throw the BufferExceededException
-	FrameId start = (clockHand + 1) % numBufs;
-	int count = 0;
-	std::uint32_t numPinnedPages = 0;
-  while(true){
-		advanceClock();
-		BufDesc * currFrame = &bufDescTable[clockHand];
-		if(clockHand == start){
-			count++;
-		}
-		//If we are at starting position, and all pages are
-		//pinned
-		if(count >= 2 && numPinnedPages == numBufs){
-			//Throw BufferExceededException
-			throw BufferExceededException();
+	std::uint64_t state = static_cast<const std::atomic<std::uint64_t>*>(context)[frameNo].load(std::memory_order_relaxed);
+	return FrameState::pinCount(state) == 0
+		&& !(state & (FrameState::IN_FREE_LIST | FrameState::WRITING | FrameState::PREFETCHED));
+}
+
+BufHashPartition& BufMgr::partitionFor(const File* file, const PageId pageNo)
+{
+	//The table itself works from the low bits of the hash
+	return hashPartitions[(PageTable::hashKey(file, pageNo) >> 32) % numPartitions];
+}
+
+bool BufMgr::claimFrame(const FrameId frameNo)
+{
+	BufDesc *currFrame = &bufDescTable[frameNo];
+	File* file;
+	PageId pageNo;
+	bool dirty;
+	{
+		std::lock_guard<BufDesc> frameGuard(*currFrame);
+		std::uint64_t state = frameState[frameNo];
+		if(FrameState::pinCount(state) > 0 || (state & FrameState::WRITING)){
+			return false;
 		}
-    //Check if valid bit is set
-    if(currFrame->valid){
-      //Check if reference bit is set or no
-      if(currFrame->refbit){
-        //Clear the ref bit
-        currFrame->refbit = false;
-        continue;
-      }
-
-      if(currFrame->pinCnt > 0){
-				numPinnedPages++;
-        continue;
-      }
-
-      //Check if dirty bit is set
-      if(currFrame->dirty){
-        //Flush this particular page to disk
-				currFrame->file->writePage(bufPool[clockHand]);
-      }
-    }
-
-		frame = currFrame->frameNo;
-		//If file pointer is not NULL
-		if(currFrame->file != NULL){
-			//Removing the evicted entry from our hashmap
-			hashTable->remove(currFrame->file, currFrame->pageNo);
-
-		}
-		//Getting the frame ready for use
-		currFrame->Clear();
-		break; //Move out of this loop
-  }
+		//An unused frame can be taken right away
+		if(!(state & FrameState::VALID)){
+			return tryPinEmpty(frameNo);
+		}
+		file = currFrame->file;
+		pageNo = currFrame->pageNo;
+		dirty = (state & FrameState::DIRTY) != 0;
+	}
+	//Flush this particular page to disk first, readers of the page are not
+	//held up by the write
+	if(dirty && !cleanFrame(frameNo)){
+		return false;
+	}
+
+	//Nobody can pin the page while we hold its partition latch, so if it is
+	//still mapped, unpinned and clean here, evicting it is safe
+	BufHashPartition& partition = partitionFor(file, pageNo);
+	std::lock_guard<std::mutex> partitionGuard(partition.latch);
+	std::lock_guard<BufDesc> frameGuard(*currFrame);
+	if(!hasFlag(frameNo, FrameState::VALID) || currFrame->file != file || currFrame->pageNo != pageNo
+		|| pinCount(frameNo) > 0 || hasFlag(frameNo, FrameState::WRITING | FrameState::DIRTY)){
+		return false;
+	}
+	//Removing the evicted entry from our hashmap
+	partition.table->remove(file, pageNo);
+	unindexFrame(file, pageNo, frameNo);
+	policy->recordEviction(frameNo, file, pageNo);
+	//Getting the frame ready for use
+	clearFrame(frameNo);
+	pinFrame(frameNo);
+	return true;
 }
 
+const std::uint64_t FrameState::PIN_MASK;
+const std::uint64_t FrameState::PIN_ONE;
+const std::uint32_t FrameState::USAGE_SHIFT;
+const std::uint64_t FrameState::USAGE_MASK;
+const std::uint64_t FrameState::USAGE_ONE;
+const std::uint32_t FrameState::MAX_USAGE;
+const std::uint64_t FrameState::VALID;
+const std::uint64_t FrameState::DIRTY;
+const std::uint64_t FrameState::LOADING;
+const std::uint64_t FrameState::IN_RING;
+const std::uint64_t FrameState::IN_FREE_LIST;
+const std::uint64_t FrameState::PREFETCHED;
+const std::uint64_t FrameState::WRITING;
+const std::uint64_t FrameState::FRAME_FLAGS;
+const std::size_t BufMgr::ARENA_ALIGNMENT;
+const std::uint32_t BufMgr::READ_AHEAD_SHARDS;
 
-//Read page
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::mapArena()
 {
-	FrameId frameNo;
-	try
+	//Whole huge pages, so frames are fixed-stride slices and nothing else shares their TLB entries
+	arenaBytes = ((std::size_t)numBufs * sizeof(Page) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+	if(arenaBytes == 0)
+	{
+		arenaBytes = ARENA_ALIGNMENT;
+	}
+	void* arena = mmap(NULL, arenaBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	arenaHugeTlb = arena != MAP_FAILED;
+	if(!arenaHugeTlb)
 	{
+		//No huge pages reserved, so over-map and trim the mapping down to an aligned arena
+		arena = mmap(NULL, arenaBytes + ARENA_ALIGNMENT, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(arena == MAP_FAILED)
+		{
+			throw std::bad_alloc();
+		}
+		char* start = static_cast<char*>(arena);
+		std::size_t head = (ARENA_ALIGNMENT - (std::uintptr_t)start % ARENA_ALIGNMENT) % ARENA_ALIGNMENT;
+		if(head > 0)
+		{
+			munmap(start, head);
+		}
+		munmap(start + head + arenaBytes, ARENA_ALIGNMENT - head);
+		arena = start + head;
+		madvise(arena, arenaBytes, MADV_HUGEPAGE);
+	}
+	bufPool = static_cast<Page*>(arena);
+}
 
-		hashTable->lookup(file, pageNo, frameNo);
-		BufDesc * frame = &bufDescTable[frameNo];
-		frame->pinCnt++;
-		frame->refbit = true;
-		page = &bufPool[frameNo];
+void BufMgr::prefaultPool(const bool background)
+{
+	if(prefaulter.joinable())
+	{
+		return;
 	}
-	//if page is not in buffer pool
-	catch (HashNotFoundException e)
+	if(background)
 	{
-		//reading page from disk into buffer pool frame
-		allocBuf(frameNo);
-		badgerdb::Page p = file->readPage(pageNo);
-		bufPool[frameNo] = p;
-		hashTable->insert(file, pageNo, frameNo);
-		bufDescTable[frameNo].Set(file, pageNo);
-		page = &bufPool[frameNo];
+		prefaulter = std::thread(&BufMgr::prefaultArena, this);
+	}
+	else
+	{
+		prefaultArena();
+	}
+}
+
+void BufMgr::prefaultArena()
+{
+	//Populating write-faults the memory without changing its contents, so it
+	//is safe while frames are in use
+	char* arena = reinterpret_cast<char*>(bufPool);
+	for (std::size_t offset = 0; offset < arenaBytes && !prefaultStop; offset += ARENA_ALIGNMENT)
+	{
+		if(madvise(arena + offset, ARENA_ALIGNMENT, MADV_POPULATE_WRITE) != 0)
+		{
+			return;
+		}
 	}
+}
 
+void BufMgr::releaseFrame(const FrameId frameNo)
+{
+	{
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		clearFrame(frameNo);
+	}
+	policy->recordFree(frameNo);
+	pushFreeFrame(frameNo);
 }
 
-//Decrement pin count of a page
-void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
+void BufMgr::clearFrame(const FrameId frameNo)
 {
-	FrameId frameNo;
-	try
+	bufDescTable[frameNo].file = NULL;
+	bufDescTable[frameNo].pageNo = Page::INVALID_NUMBER;
+	frameState[frameNo].fetch_and(FrameState::FRAME_FLAGS);
+}
+
+void BufMgr::setFrame(const FrameId frameNo, File* file, const PageId pageNo, const std::uint64_t flags)
+{
+	bufDescTable[frameNo].file = file;
+	bufDescTable[frameNo].pageNo = pageNo;
+	std::uint64_t state = frameState[frameNo];
+	while(!frameState[frameNo].compare_exchange_weak(state,
+		(state & FrameState::FRAME_FLAGS) | FrameState::VALID | FrameState::PIN_ONE | flags))
+	{
+	}
+}
+
+bool BufMgr::tryPinEmpty(const FrameId frameNo)
+{
+	std::uint64_t state = frameState[frameNo];
+	do
+	{
+		if(FrameState::pinCount(state) > 0 || (state & FrameState::VALID))
+		{
+			return false;
+		}
+	} while(!frameState[frameNo].compare_exchange_weak(state, state + FrameState::PIN_ONE));
+	return true;
+}
+
+bool BufMgr::pinIfLoaded(const FrameId frameNo)
+{
+	std::uint64_t state = frameState[frameNo];
+	do
 	{
-		hashTable->lookup(file, pageNo, frameNo);
-		BufDesc *frame = &bufDescTable[frameNo];
-		if(frame->pinCnt == 0)
+		if(state & FrameState::LOADING)
 		{
-			throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+			return false;
 		}
+	} while(!frameState[frameNo].compare_exchange_weak(state, state + FrameState::PIN_ONE));
+	return true;
+}
 
-		frame->pinCnt--;
+void BufMgr::indexFrame(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+	std::lock_guard<std::mutex> indexGuard(fileFramesLatch);
+	fileFrames[file->filename()].insert(std::make_pair(pageNo, frameNo));
+}
 
-		if(dirty)
+void BufMgr::unindexFrame(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+	std::lock_guard<std::mutex> indexGuard(fileFramesLatch);
+	std::unordered_map<std::string, std::multimap<PageId, FrameId> >::iterator frames
+		= fileFrames.find(file->filename());
+	if(frames == fileFrames.end())
+	{
+		return;
+	}
+	//Other File objects of the file may have the page in frames of their own
+	std::pair<std::multimap<PageId, FrameId>::iterator, std::multimap<PageId, FrameId>::iterator> entries
+		= frames->second.equal_range(pageNo);
+	for(std::multimap<PageId, FrameId>::iterator entry = entries.first; entry != entries.second; ++entry)
+	{
+		if(entry->second == frameNo)
 		{
-			frame->dirty = true;
+			frames->second.erase(entry);
+			break;
 		}
+	}
+	//Files with nothing left in the pool take no space
+	if(frames->second.empty())
+	{
+		fileFrames.erase(frames);
+	}
+}
 
+void BufMgr::pushFreeFrame(const FrameId frameNo)
+{
+	{
+		std::lock_guard<std::mutex> freeGuard(freeLatch);
+		if(hasFlag(frameNo, FrameState::IN_FREE_LIST))
+		{
+			return;
+		}
+		setFlags(frameNo, FrameState::IN_FREE_LIST);
+		freeFrames.push_back(frameNo);
+		numFree++;
 	}
-	catch (HashNotFoundException e)
+	notifyFrameReleased();
+}
+
+bool BufMgr::popFreeFrame(FrameId & frame)
+{
+	while(true)
 	{
-		//Do nothing if the entry is not found in the buffer
-		return;
+		FrameId frameNo;
+		{
+			std::lock_guard<std::mutex> freeGuard(freeLatch);
+			if(!freeFrames.empty())
+			{
+				frameNo = freeFrames.back();
+				freeFrames.pop_back();
+				clearFlags(frameNo, FrameState::IN_FREE_LIST);
+			}
+			else if(nextUnusedFrame < numBufs)
+			{
+				frameNo = nextUnusedFrame++;
+			}
+			else
+			{
+				return false;
+			}
+			numFree--;
+		}
+		if(evictor.joinable() && numFree < evictionConfig.lowWater)
+		{
+			evictorWake.notify_one();
+		}
+
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		//Skip frames the replacement policy handed out since they were freed
+		if(tryPinEmpty(frameNo))
+		{
+			frame = frameNo;
+			return true;
+		}
 	}
+}
+
+std::uint32_t BufMgr::evictBatch(const std::uint32_t count, FrameId* frame)
+{
+  //Keep asking for victims until enough are claimed, the policy gives up
+	//once it finds every frame pinned
+	std::uint32_t evicted = 0;
+	FrameId frameNo;
+  while(evicted < count && policy->pickVictim(frameNo, evictable)){
+		if(claimFrame(frameNo)){
+			if(frame && evicted == 0){
+				*frame = frameNo;
+			}
+			else{
+				releaseFrame(frameNo);
+			}
+			evicted++;
+		}
+  }
+	return evicted;
+}
 
+//Will try to return an empty frame from the memory pool,
+bool BufMgr::tryAllocBuf(FrameId & frame)
+{
+	if(popFreeFrame(frame))
+	{
+		return true;
+	}
+	//A background evictor refills the list, so only evict for this miss
+	return evictBatch(evictor.joinable() ? 1 : evictionConfig.batch, &frame) > 0;
 }
 
-void BufMgr::flushFile(const File* file)
+bool BufMgr::tryAllocBufs(const std::uint32_t count, std::vector<FrameId>& frames)
 {
-	//Check if this frame holds the page for this file
-	//Delete all pages for this file
-	for(FrameId i = 0; i < numBufs; i++)
+	FrameId frameNo;
+	while(frames.size() < count && popFreeFrame(frameNo))
+	{
+		frames.push_back(frameNo);
+	}
+	//Claimed frames are pinned, so the policy does not propose them again
+	while(frames.size() < count && policy->pickVictim(frameNo, evictable))
 	{
-		BufDesc *frame = &bufDescTable[i];
-		if(frame->file->filename() == file->filename())
+		if(claimFrame(frameNo))
 		{
-			//If this page is pinned
-			if(frame->pinCnt > 0){
-				throw PagePinnedException(frame->file->filename(), frame->pageNo, frame->frameNo);
+			frames.push_back(frameNo);
+		}
+	}
+	return frames.size() == count;
+}
+
+FrameId& BufMgr::nextRingSlot(BufferAccessStrategy* strategy)
+{
+	//Rings never take more than an eighth of the pool
+	std::size_t ringSize = std::min<std::size_t>(strategy->ring.size(), std::max<std::uint32_t>(numBufs / 8, 1));
+	if(strategy->current >= ringSize)
+	{
+		strategy->current = 0;
+	}
+	FrameId& slot = strategy->ring[strategy->current];
+	strategy->current = (strategy->current + 1) % ringSize;
+	return slot;
+}
+
+bool BufMgr::reuseRingFrame(const BufferAccessStrategy* strategy, const FrameId frameNo)
+{
+	if(frameNo == BufferAccessStrategy::NO_FRAME)
+	{
+		return false;
+	}
+	std::uint64_t state = frameState[frameNo];
+	//Recycle the frame unless its page was picked up outside the ring, or a
+	//scan would have to write it back first
+	return (state & FrameState::IN_RING) && !(strategy->type == StrategyType::BULKREAD && (state & FrameState::DIRTY))
+		&& claimFrame(frameNo);
+}
+
+bool BufMgr::tryAllocRingBuf(BufferAccessStrategy* strategy, FrameId & frame)
+{
+	FrameId& slot = nextRingSlot(strategy);
+	if(reuseRingFrame(strategy, slot))
+	{
+		frame = slot;
+		return true;
+	}
+	if(!tryAllocBuf(frame))
+	{
+		return false;
+	}
+	slot = frame;
+	return true;
+}
+
+bool BufMgr::tryAllocAdmitted(const File* file, const PageId pageNo, FrameId & frame, bool & inWindow)
+{
+	//Empty frames are always admitted
+	if(popFreeFrame(frame))
+	{
+		inWindow = false;
+		return true;
+	}
+	std::uint32_t incoming = sketch->estimate(PageTable::hashKey(file, pageNo));
+	std::unique_lock<std::mutex> windowGuard(windowLatch, std::defer_lock);
+	FrameId* windowSlot = NULL;
+	std::uint32_t candidates = 0;
+	FrameId victim;
+	while(policy->pickVictim(victim, evictable))
+	{
+		//Empty frames and ring pages are worth nothing to the main pool
+		BufDesc* victimFrame = &bufDescTable[victim];
+		std::uint32_t victimCount = 0;
+		{
+			std::lock_guard<BufDesc> frameGuard(*victimFrame);
+			std::uint64_t state = frameState[victim];
+			if((state & FrameState::VALID) && !(state & (FrameState::IN_RING | FrameState::PREFETCHED)))
+			{
+				victimCount = sketch->estimate(PageTable::hashKey(victimFrame->file, victimFrame->pageNo));
 			}
-			//If page is invalid_page_exception
-			if(!frame->valid){
-				throw BadBufferException(frame->frameNo, frame->dirty, frame->valid, frame->refbit);
+		}
+
+		if(windowSlot == NULL && victimCount > 0 && incoming <= victimCount)
+		{
+			//The page loses against the victim, so it goes to the window
+			windowGuard.lock();
+			windowSlot = &nextRingSlot(admissionWindow);
+			if(reuseRingFrame(admissionWindow, *windowSlot))
+			{
+				frame = *windowSlot;
+				inWindow = true;
+				return true;
 			}
+		}
+		//A window short of a frame takes one worth no more than the page
+		if(windowSlot != NULL && victimCount > incoming && ++candidates < numBufs)
+		{
+			continue;
+		}
 
-			if(frame->dirty)
+		if(claimFrame(victim))
+		{
+			frame = victim;
+			inWindow = windowSlot != NULL;
+			if(inWindow)
 			{
-				frame->file->writePage(bufPool[frame->frameNo]);
-				frame->dirty = false;
+				*windowSlot = victim;
 			}
-			//Remove this particular file, page # mapping from the hashmap
-			hashTable->remove(file, frame->pageNo);
-			frame->Clear();
+			return true;
 		}
 	}
+	return false;
 }
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
+void BufMgr::allocBuf(FrameId & frame)
 {
-	FrameId frameNo;
-	badgerdb::Page p = file->allocatePage();
-	allocBuf(frameNo);
-	//Assign the corresponding page to the frameNo
-	bufPool[frameNo] = p;
-	pageNo = p.page_number();
-	hashTable->insert(file, pageNo, frameNo);
-	bufDescTable[frameNo].Set(file, pageNo);
-	//Return a pointer to that page
-	page = &bufPool[frameNo];
+	if(!tryAllocBuf(frame) && !awaitFrame([this, &frame]() { return tryAllocBuf(frame); })){
+		throw BufferExceededException();
+	}
 }
 
-void BufMgr::disposePage(File* file, const PageId PageNo)
+bool BufMgr::awaitFrame(const std::function<bool()>& tryAlloc)
 {
-  try{
-		FrameId frameNo;
-		hashTable->lookup(file, PageNo, frameNo);
-		hashTable->remove(file,PageNo);
-		bufDescTable[frameNo].Clear();
-		file->deletePage(PageNo);
+	if(evictionConfig.allocTimeoutMs == 0)
+	{
+		return false;
+	}
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+		+ std::chrono::milliseconds(evictionConfig.allocTimeoutMs);
+	std::unique_lock<std::mutex> guard(allocLatch);
+	allocWaiters++;
+	bool allocated = false;
+	while(true)
+	{
+		//Registered before trying again, so an unpin racing with the attempt
+		//is either seen by it or counted in frameReleases
+		std::uint64_t seen = frameReleases;
+		guard.unlock();
+		try
+		{
+			allocated = tryAlloc();
+		}
+		catch (...)
+		{
+			guard.lock();
+			allocWaiters--;
+			throw;
+		}
+		guard.lock();
+		if(allocated || !frameReleased.wait_until(guard, deadline, [this, seen]() { return frameReleases != seen; }))
+		{
+			break;
+		}
 	}
-	catch(HashNotFoundException e){
+	allocWaiters--;
+	return allocated;
+}
+
+void BufMgr::notifyFrameReleased()
+{
+	if(allocWaiters == 0)
+	{
 		return;
 	}
+	{
+		std::lock_guard<std::mutex> guard(allocLatch);
+		frameReleases++;
+	}
+	//Waking them all would only have them fight over the one frame
+	frameReleased.notify_one();
 }
 
-void BufMgr::printSelf(void)
+
+//Read page
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufferAccessStrategy* strategy)
 {
-  BufDesc* tmpbuf;
-	int validFrames = 0;
+	//The I/O error is thrown as the file raised it
+	std::exception_ptr ioError;
+	switch(fetchPage(file, pageNo, page, strategy, &ioError))
+	{
+		case BufStatus::BUFFER_EXCEEDED:
+			throw BufferExceededException();
+		case BufStatus::INVALID_PAGE:
+			throw InvalidPageException(pageNo, file->filename());
+		case BufStatus::IO_ERROR:
+			std::rethrow_exception(ioError);
+		default:
+			break;
+	}
+}
 
-  for (std::uint32_t i = 0; i < numBufs; i++)
+BufStatus BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page, BufferAccessStrategy* strategy)
+{
+	return fetchPage(file, pageNo, page, strategy, NULL);
+}
+
+BufStatus BufMgr::fetchPage(File* file, const PageId pageNo, Page*& page, BufferAccessStrategy* strategy,
+	std::exception_ptr* ioError)
+{
+	FrameId frameNo;
+	BufStatus status = pinPage(file, pageNo, frameNo, strategy, ioError);
+	if(status == BufStatus::OK)
 	{
-  	tmpbuf = &(bufDescTable[i]);
-		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		page = &bufPool[frameNo];
+		if(readAheadEnabled)
+		{
+			readAhead(file, pageNo);
+		}
+	}
+	return status;
+}
+
+void BufMgr::readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages)
+{
+	const std::size_t count = pageNos.size();
+	//Frame pinned for every page so far, numBufs if none yet
+	std::vector<FrameId> frames(count, numBufs);
+	auto unpinAll = [this, &frames]() {
+		for(std::size_t i = 0; i < frames.size(); i++)
+		{
+			if(frames[i] != numBufs)
+			{
+				unpinFrame(frames[i], false);
+			}
+		}
+	};
+
+	//Pin the resident pages in one pass; pages still loading count as missed
+	std::vector<std::size_t> missed;
+	for(std::size_t i = 0; i < count; i++)
+	{
+		BufHashPartition& partition = partitionFor(file, pageNos[i]);
+		FrameId frameNo;
+		bool pinned;
+		{
+			std::lock_guard<std::mutex> partitionGuard(partition.latch);
+			pinned = partition.table->tryLookup(file, pageNos[i], frameNo) && pinIfLoaded(frameNo);
+		}
+		if(!pinned)
+		{
+			missed.push_back(i);
+			continue;
+		}
+		bufStats.accesses++;
+		if(sketch)
+		{
+			sketch->increment(PageTable::hashKey(file, pageNos[i]));
+		}
+		recordHit(frameNo, NULL);
+		frames[i] = frameNo;
+	}
+
+	//Each missed page is read once; repeats, and pages someone else is
+	//reading in, are pinned by pinPage() once our reads are done
+	std::sort(missed.begin(), missed.end(), [&pageNos](const std::size_t lhs, const std::size_t rhs) {
+		return pageNos[lhs] < pageNos[rhs] || (pageNos[lhs] == pageNos[rhs] && lhs < rhs);
+	});
+	std::vector<std::size_t> loads;
+	std::vector<std::size_t> later;
+	for(std::size_t i = 0; i < missed.size(); i++)
+	{
+		if(i > 0 && pageNos[missed[i]] == pageNos[missed[i - 1]])
+			later.push_back(missed[i]);
+		else
+			loads.push_back(missed[i]);
+	}
+
+	std::vector<FrameId> newFrames;
+	try
+	{
+		const std::uint32_t wanted = loads.size();
+		if(!tryAllocBufs(wanted, newFrames)
+			&& !awaitFrame([this, wanted, &newFrames]() { return tryAllocBufs(wanted, newFrames); }))
+		{
+			throw BufferExceededException();
+		}
+	}
+	catch (...)
+	{
+		for(std::size_t k = 0; k < newFrames.size(); k++)
+		{
+			releaseFrame(newFrames[k]);
+		}
+		unpinAll();
+		throw;
+	}
+
+	//Publish the missing pages as loading, so concurrent readers of them wait
+	//for our reads instead of reading them again
+	std::vector<std::size_t> loading;
+	std::vector<PageId> readNos;
+	std::vector<Page*> readInto;
+	for(std::size_t k = 0; k < loads.size(); k++)
+	{
+		const std::size_t i = loads[k];
+		const FrameId frameNo = newFrames[k];
+		BufHashPartition& partition = partitionFor(file, pageNos[i]);
+		{
+			std::lock_guard<std::mutex> partitionGuard(partition.latch);
+			FrameId loadedFrameNo;
+			if(!partition.table->tryLookup(file, pageNos[i], loadedFrameNo))
+			{
+				partition.table->insert(file, pageNos[i], frameNo);
+				indexFrame(file, pageNos[i], frameNo);
+				std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+				setFrame(frameNo, file, pageNos[i], FrameState::LOADING);
+				frames[i] = frameNo;
+			}
+		}
+		if(frames[i] == numBufs)
+		{
+			//Another thread read the page in while we were sweeping
+			releaseFrame(frameNo);
+			later.push_back(i);
+			continue;
+		}
+		bufStats.accesses++;
+		if(sketch)
+		{
+			sketch->increment(PageTable::hashKey(file, pageNos[i]));
+		}
+		loading.push_back(i);
+		readNos.push_back(pageNos[i]);
+		readInto.push_back(&bufPool[frameNo]);
+	}
+
+	std::exception_ptr error;
+	try
+	{
+		if(!readNos.empty())
+		{
+			file->readPages(readNos, readInto);
+		}
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	//Failed pages are taken back out of the pool and their frames freed
+	for(std::size_t k = 0; k < loading.size(); k++)
+	{
+		const std::size_t i = loading[k];
+		finishLoad(file, pageNos[i], frames[i], error, [](const BufStatus, Page*) {});
+		if(error)
+		{
+			frames[i] = numBufs;
+		}
+	}
+	if(error)
+	{
+		unpinAll();
+		std::rethrow_exception(error);
+	}
+
+	for(std::size_t k = 0; k < later.size(); k++)
+	{
+		const std::size_t i = later[k];
+		BufStatus status = pinPage(file, pageNos[i], frames[i], NULL, &error);
+		if(status != BufStatus::OK)
+		{
+			frames[i] = numBufs;
+			unpinAll();
+			if(status == BufStatus::IO_ERROR)
+				std::rethrow_exception(error);
+			if(status == BufStatus::BUFFER_EXCEEDED)
+				throw BufferExceededException();
+			throw InvalidPageException(pageNos[i], file->filename());
+		}
+	}
+
+	pages.resize(count);
+	for(std::size_t i = 0; i < count; i++)
+	{
+		pages[i] = &bufPool[frames[i]];
+	}
+}
+
+ReadPageGuard BufMgr::readPageGuarded(File* file, const PageId pageNo, BufferAccessStrategy* strategy)
+{
+	Page* page;
+	readPage(file, pageNo, page, strategy);
+	return ReadPageGuard(this, page - bufPool, page);
+}
+
+WritePageGuard BufMgr::writePageGuarded(File* file, const PageId pageNo, BufferAccessStrategy* strategy)
+{
+	Page* page;
+	readPage(file, pageNo, page, strategy);
+	return WritePageGuard(this, page - bufPool, page);
+}
+
+void BufMgr::recordHit(const FrameId frameNo, const BufferAccessStrategy* strategy)
+{
+	if(strategy == NULL)
+	{
+		//The page is wanted outside the ring, so the ring must not recycle it
+		if(hasFlag(frameNo, FrameState::IN_RING))
+		{
+			clearFlags(frameNo, FrameState::IN_RING);
+		}
+		//The first pin of a page read ahead is when it really arrives, so a
+		//policy telling new pages from reused ones is not fooled by read-ahead
+		if(hasFlag(frameNo, FrameState::PREFETCHED)
+			&& (frameState[frameNo].fetch_and(~FrameState::PREFETCHED) & FrameState::PREFETCHED))
+		{
+			policy->recordLoad(frameNo, bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo);
+			return;
+		}
+		policy->recordAccess(frameNo);
+	}
+}
+
+BufStatus BufMgr::pinPage(File* file, const PageId pageNo, FrameId& frameNo, BufferAccessStrategy* strategy,
+	std::exception_ptr* ioError)
+{
+	BufHashPartition& partition = partitionFor(file, pageNo);
+	bool hit;
+	bool loading = false;
+	{
+		std::lock_guard<std::mutex> partitionGuard(partition.latch);
+		hit = partition.table->tryLookup(file, pageNo, frameNo);
+		loading = hit && !pinIfLoaded(frameNo);
+	}
+	//The page is on its way in asynchronously, or the read fails and we read it ourselves
+	if(loading)
+	{
+		awaitLoad(frameNo);
+		return pinPage(file, pageNo, frameNo, strategy, ioError);
+	}
+	bufStats.accesses++;
+	//Scans through a strategy would only flood the sketch with one-time pages
+	if(sketch && strategy == NULL)
+	{
+		sketch->increment(PageTable::hashKey(file, pageNo));
+	}
+	if(hit)
+	{
+		recordHit(frameNo, strategy);
+		return BufStatus::OK;
+	}
+
+	//if page is not in buffer pool, read it from disk into a buffer pool frame
+	bool inWindow = false;
+	//Only wrapped in a std::function if the pool is full and we have to wait
+	auto alloc = [this, file, pageNo, strategy, &frameNo, &inWindow]() {
+		if(strategy)
+			return tryAllocRingBuf(strategy, frameNo);
+		if(sketch)
+			return tryAllocAdmitted(file, pageNo, frameNo, inWindow);
+		return tryAllocBuf(frameNo);
+	};
+	//Writing back a dirty victim can fail too
+	bool allocated;
+	try
+	{
+		allocated = alloc() || awaitFrame(alloc);
+	}
+	catch (...)
+	{
+		if(ioError)
+		{
+			*ioError = std::current_exception();
+		}
+		return BufStatus::IO_ERROR;
+	}
+	if(!allocated)
+	{
+		return BufStatus::BUFFER_EXCEEDED;
+	}
+	std::unique_lock<std::mutex> partitionGuard(partition.latch);
+	//Another thread may have read the page in while we were sweeping
+	FrameId loadedFrameNo;
+	if(partition.table->tryLookup(file, pageNo, loadedFrameNo))
+	{
+		if(!pinIfLoaded(loadedFrameNo))
+		{
+			partitionGuard.unlock();
+			releaseFrame(frameNo);
+			awaitLoad(loadedFrameNo);
+			return pinPage(file, pageNo, frameNo, strategy, ioError);
+		}
+		partitionGuard.unlock();
+		releaseFrame(frameNo);
+		recordHit(loadedFrameNo, strategy);
+		frameNo = loadedFrameNo;
+		return BufStatus::OK;
+	}
+
+	//Publish the page as loading and read it without the partition latch, so
+	//misses on other pages of the partition do not wait for the read
+	partition.table->insert(file, pageNo, frameNo);
+	indexFrame(file, pageNo, frameNo);
+	{
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		setFrame(frameNo, file, pageNo, FrameState::LOADING | (strategy != NULL || inWindow ? FrameState::IN_RING : 0));
+	}
+	partitionGuard.unlock();
+	std::exception_ptr error;
+	try
+	{
+		file->readPage(pageNo, &bufPool[frameNo]);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	BufStatus status = BufStatus::OK;
+	finishLoad(file, pageNo, frameNo, error, [&status](const BufStatus loaded, Page*) { status = loaded; });
+	if(status == BufStatus::IO_ERROR && ioError)
+	{
+		*ioError = error;
+	}
+	return status;
+}
+
+//Decrement pin count of a page
+void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+	if(tryUnpin(file, pageNo, dirty) == BufStatus::NOT_PINNED)
+	{
+		FrameId frameNo = 0;
+		BufHashPartition& partition = partitionFor(file, pageNo);
+		{
+			std::lock_guard<std::mutex> partitionGuard(partition.latch);
+			partition.table->tryLookup(file, pageNo, frameNo);
+		}
+		throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+	}
+	//Do nothing if the entry is not found in the buffer
+}
+
+BufStatus BufMgr::tryUnpin(File* file, const PageId pageNo, const bool dirty)
+{
+	FrameId frameNo;
+	BufHashPartition& partition = partitionFor(file, pageNo);
+	std::lock_guard<std::mutex> partitionGuard(partition.latch);
+	if(!partition.table->tryLookup(file, pageNo, frameNo))
+	{
+		return BufStatus::NOT_FOUND;
+	}
+	return unpinFrame(frameNo, dirty) ? BufStatus::OK : BufStatus::NOT_PINNED;
+}
+
+void BufMgr::unPinPages(File* file, const std::vector<PageId>& pageNos, const bool dirty)
+{
+	//First page found unpinned and its frame, reported once all are done
+	const PageId* notPinned = NULL;
+	FrameId notPinnedFrame = 0;
+	for(std::size_t i = 0; i < pageNos.size(); i++)
+	{
+		FrameId frameNo;
+		BufHashPartition& partition = partitionFor(file, pageNos[i]);
+		std::lock_guard<std::mutex> partitionGuard(partition.latch);
+		if(partition.table->tryLookup(file, pageNos[i], frameNo) && !unpinFrame(frameNo, dirty)
+			&& notPinned == NULL)
+		{
+			notPinned = &pageNos[i];
+			notPinnedFrame = frameNo;
+		}
+	}
+	if(notPinned)
+	{
+		throw PageNotPinnedException(file->filename(), *notPinned, notPinnedFrame);
+	}
+}
+
+bool BufMgr::unpinFrame(const FrameId frameNo, const bool dirty)
+{
+	std::uint64_t state = frameState[frameNo];
+	do
+	{
+		if(FrameState::pinCount(state) == 0)
+		{
+			return false;
+		}
+		//Mark the page dirty in the same step that drops the pin, so an
+		//evictor that sees the frame unpinned also sees it dirty
+	} while(!frameState[frameNo].compare_exchange_weak(state,
+		(state - FrameState::PIN_ONE) | (dirty ? FrameState::DIRTY : 0)));
+	policy->recordUnpin(frameNo);
+	if(FrameState::pinCount(state) == 1)
+	{
+		notifyFrameReleased();
+	}
+	return true;
+}
+
+void BufMgr::flushFile(const File* file)
+{
+	evictFile(file, true);
+	//The pages written back are only durable once synced
+	file->sync();
+}
+
+void BufMgr::dropFile(const File* file)
+{
+	evictFile(file, false);
+}
+
+void BufMgr::evictFile(const File* file, const bool writeBack)
+{
+	//A scan of the file starts over once its pages are gone
+	{
+		ReadAheadShard& shard = readAheadShards[file->id() % READ_AHEAD_SHARDS];
+		std::lock_guard<std::mutex> guard(shard.latch);
+		shard.states.erase(file->id());
+	}
+
+	//Only this file's frames, in page order
+	std::vector<std::pair<PageId, FrameId> > frames;
+	{
+		std::lock_guard<std::mutex> indexGuard(fileFramesLatch);
+		std::unordered_map<std::string, std::multimap<PageId, FrameId> >::const_iterator fileEntry
+			= fileFrames.find(file->filename());
+		if(fileEntry == fileFrames.end())
+		{
+			return;
+		}
+		frames.assign(fileEntry->second.begin(), fileEntry->second.end());
+	}
+
+	//Frames pinned by us and the dirty pages among them, written together
+	//once all are collected
+	std::vector<FrameId> pinned;
+	std::vector<const Page*> dirtyPages;
+	File* writeFile = NULL;
+	try
+	{
+		//Delete all pages for this file
+		for(std::size_t j = 0; j < frames.size(); j++)
+		{
+			const FrameId i = frames[j].second;
+			BufDesc *frame = &bufDescTable[i];
+			//Reads still in flight, such as read-ahead, finish first, and so do
+			//write-backs of the cleaner
+			if(hasFlag(i, FrameState::LOADING))
+			{
+				awaitLoad(i);
+			}
+			if(hasFlag(i, FrameState::WRITING))
+			{
+				awaitWrite(i);
+			}
+			File* frameFile;
+			PageId framePageNo;
+			{
+				std::lock_guard<BufDesc> frameGuard(*frame);
+				if(frame->file == NULL || frame->pageNo != frames[j].first
+					|| frame->file->filename() != file->filename())
+				{
+					continue;
+				}
+				frameFile = frame->file;
+				framePageNo = frame->pageNo;
+			}
+
+			BufHashPartition& partition = partitionFor(frameFile, framePageNo);
+			std::lock_guard<std::mutex> partitionGuard(partition.latch);
+			std::lock_guard<BufDesc> frameGuard(*frame);
+			//The frame was evicted or reused since we looked at it
+			if(frame->file != frameFile || frame->pageNo != framePageNo)
+			{
+				continue;
+			}
+			std::uint64_t state = frameState[i];
+			//The cleaner started writing the page since we waited, so wait again
+			if(state & FrameState::WRITING){
+				j--;
+				continue;
+			}
+			//If this page is pinned
+			if(FrameState::pinCount(state) > 0){
+				throw PagePinnedException(frame->file->filename(), frame->pageNo, i);
+			}
+			//If page is invalid_page_exception
+			if(!(state & FrameState::VALID)){
+				//Reference state lives in the replacement policy
+				throw BadBufferException(i, (state & FrameState::DIRTY) != 0, false, false);
+			}
+
+			//Pin the page so it stays put while written, readers still find it
+			pinFrame(i);
+			pinned.push_back(i);
+			if((state & FrameState::DIRTY) && writeBack)
+			{
+				writeFile = frameFile;
+				dirtyPages.push_back(&bufPool[i]);
+			}
+			clearFlags(i, FrameState::DIRTY);
+		}
+	}
+	catch (...)
+	{
+		//Pages already pinned are still written back
+		try
+		{
+			writeAndRelease(writeFile, dirtyPages, pinned);
+		}
+		catch (...)
+		{
+		}
+		throw;
+	}
+	writeAndRelease(writeFile, dirtyPages, pinned);
+}
+
+void BufMgr::writeAndRelease(File* file, const std::vector<const Page*>& pages,
+	const std::vector<FrameId>& frames)
+{
+	try
+	{
+		if(!pages.empty())
+		{
+			file->writePages(pages);
+			bufStats.diskwrites += pages.size();
+		}
+	}
+	catch (...)
+	{
+		//Nothing was written, so the pages are dirty again and stay
+		for(std::size_t i = 0; i < pages.size(); i++)
+		{
+			setFlags(pages[i] - bufPool, FrameState::DIRTY);
+		}
+		for(std::size_t i = 0; i < frames.size(); i++)
+		{
+			evictPinned(frames[i]);
+		}
+		throw;
+	}
+	for(std::size_t i = 0; i < frames.size(); i++)
+	{
+		evictPinned(frames[i]);
+	}
+}
+
+void BufMgr::evictPinned(const FrameId frameNo)
+{
+	BufDesc* frame = &bufDescTable[frameNo];
+	//Our pin keeps the page in the frame
+	BufHashPartition& partition = partitionFor(frame->file, frame->pageNo);
+	std::lock_guard<std::mutex> partitionGuard(partition.latch);
+	std::lock_guard<BufDesc> frameGuard(*frame);
+	//Leave pages that were pinned or changed meanwhile to whoever did it
+	std::uint64_t state = frameState[frameNo];
+	if(FrameState::pinCount(state) > 1 || (state & FrameState::DIRTY))
+	{
+		frameState[frameNo].fetch_sub(FrameState::PIN_ONE);
+		return;
+	}
+	//Remove this particular file, page # mapping from the hashmap
+	partition.table->remove(frame->file, frame->pageNo);
+	unindexFrame(frame->file, frame->pageNo, frameNo);
+	clearFrame(frameNo);
+	policy->recordFree(frameNo);
+	pushFreeFrame(frameNo);
+}
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page, BufferAccessStrategy* strategy)
+{
+	FrameId frameNo;
+	pinNewPage(file, pageNo, frameNo, strategy);
+	//Return a pointer to that page
+	page = &bufPool[frameNo];
+}
+
+WritePageGuard BufMgr::allocPageGuarded(File* file, PageId &pageNo, BufferAccessStrategy* strategy)
+{
+	FrameId frameNo;
+	pinNewPage(file, pageNo, frameNo, strategy);
+	return WritePageGuard(this, frameNo, &bufPool[frameNo]);
+}
+
+void BufMgr::pinNewPage(File* file, PageId &pageNo, FrameId& frameNo, BufferAccessStrategy* strategy)
+{
+	if(strategy == NULL)
+	{
+		allocBuf(frameNo);
+	}
+	else if(!tryAllocRingBuf(strategy, frameNo)
+					&& !awaitFrame([this, strategy, &frameNo]() { return tryAllocRingBuf(strategy, frameNo); }))
+	{
+		throw BufferExceededException();
+	}
+	//The new page is built right in the frame
+	try
+	{
+		file->allocatePage(&bufPool[frameNo]);
+		bufStats.diskreads++;
+	}
+	catch (...)
+	{
+		releaseFrame(frameNo);
+		throw;
+	}
+	pageNo = bufPool[frameNo].page_number();
+	BufHashPartition& partition = partitionFor(file, pageNo);
+	{
+		std::lock_guard<std::mutex> partitionGuard(partition.latch);
+		partition.table->insert(file, pageNo, frameNo);
+		indexFrame(file, pageNo, frameNo);
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		setFrame(frameNo, file, pageNo, strategy != NULL ? FrameState::IN_RING : 0);
+	}
+	bufStats.accesses++;
+	if(strategy == NULL)
+	{
+		policy->recordLoad(frameNo, file, pageNo);
+	}
+}
+
+void BufMgr::disposePage(File* file, const PageId PageNo)
+{
+	BufHashPartition& partition = partitionFor(file, PageNo);
+	std::unique_lock<std::mutex> partitionGuard(partition.latch);
+	FrameId frameNo;
+	//A read into the frame still in flight would land in it after it was
+	//freed, and a write-back could land after the page was deleted, so both
+	//finish first
+	while(partition.table->tryLookup(file, PageNo, frameNo)
+		&& hasFlag(frameNo, FrameState::LOADING | FrameState::WRITING))
+	{
+		partitionGuard.unlock();
+		awaitLoad(frameNo);
+		awaitWrite(frameNo);
+		partitionGuard.lock();
+	}
+	//A page not in the pool is left in the file
+	if(!partition.table->tryLookup(file, PageNo, frameNo))
+	{
+		return;
+	}
+	partition.table->remove(file,PageNo);
+	unindexFrame(file, PageNo, frameNo);
+	{
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		clearFrame(frameNo);
+		policy->recordFree(frameNo);
+		pushFreeFrame(frameNo);
+	}
+	file->deletePage(PageNo);
+}
+
+void BufMgr::enableAdmission(const std::uint32_t windowFrames)
+{
+	if(sketch)
+	{
+		return;
+	}
+	sketch = new FrequencySketch(numBufs);
+	admissionWindow = new BufferAccessStrategy(StrategyType::BULKREAD,
+		windowFrames > 0 ? windowFrames : std::max<std::uint32_t>(numBufs / 100, 1));
+}
+
+void BufMgr::enableAsyncIo(const std::uint32_t queueDepth)
+{
+	if(ioEngine)
+	{
+		return;
+	}
+	ioQueueDepth = std::max<std::uint32_t>(queueDepth, 1);
+	ioEngine = new IoEngine(ioQueueDepth);
+}
+
+void BufMgr::readPageAsync(File* file, const PageId pageNo, const ReadCallback& done)
+{
+	FrameId frameNo;
+	if(ioEngine == NULL)
+	{
+		BufStatus status = pinPage(file, pageNo, frameNo, NULL, NULL);
+		done(status, status == BufStatus::OK ? &bufPool[frameNo] : NULL);
+		return;
+	}
+
+	BufHashPartition& partition = partitionFor(file, pageNo);
+	std::unique_lock<std::mutex> partitionGuard(partition.latch);
+	bool hit = partition.table->tryLookup(file, pageNo, frameNo);
+	if(!hit)
+	{
+		partitionGuard.unlock();
+		FrameId newFrameNo;
+		//Writing back a dirty victim can fail too
+		BufStatus allocStatus = BufStatus::OK;
+		try
+		{
+			if(!tryAllocBuf(newFrameNo))
+			{
+				allocStatus = BufStatus::BUFFER_EXCEEDED;
+			}
+		}
+		catch (...)
+		{
+			allocStatus = BufStatus::IO_ERROR;
+		}
+		if(allocStatus != BufStatus::OK)
+		{
+			done(allocStatus, NULL);
+			return;
+		}
+		partitionGuard.lock();
+		//Another thread may have read the page in while we were sweeping
+		hit = partition.table->tryLookup(file, pageNo, frameNo);
+		if(hit)
+		{
+			releaseFrame(newFrameNo);
+		}
+		else
+		{
+			partition.table->insert(file, pageNo, newFrameNo);
+			indexFrame(file, pageNo, newFrameNo);
+			{
+				std::lock_guard<BufDesc> frameGuard(bufDescTable[newFrameNo]);
+				setFrame(newFrameNo, file, pageNo, FrameState::LOADING);
+			}
+			partitionGuard.unlock();
+			bufStats.accesses++;
+			if(sketch)
+			{
+				sketch->increment(PageTable::hashKey(file, pageNo));
+			}
+			file->readPageAsync(*ioEngine, pageNo, &bufPool[newFrameNo],
+				[this, file, pageNo, newFrameNo, done](std::exception_ptr error) {
+					finishLoad(file, pageNo, newFrameNo, error, done);
+				});
+			if(ioEngine->pendingCount() >= ioQueueDepth)
+			{
+				ioEngine->submit();
+			}
+			return;
+		}
+	}
+
+	//Wait for a read already in flight without blocking
+	if(hasFlag(frameNo, FrameState::LOADING))
+	{
+		std::lock_guard<std::mutex> loadGuard(loadLatch);
+		if(hasFlag(frameNo, FrameState::LOADING))
+		{
+			loadWaiters[frameNo].push_back([this, file, pageNo, done]() {
+				readPageAsync(file, pageNo, done);
+			});
+			return;
+		}
+	}
+	pinFrame(frameNo);
+	partitionGuard.unlock();
+	bufStats.accesses++;
+	if(sketch)
+	{
+		sketch->increment(PageTable::hashKey(file, pageNo));
+	}
+	recordHit(frameNo, NULL);
+	done(BufStatus::OK, &bufPool[frameNo]);
+}
+
+std::future<Page*> BufMgr::readPageAsync(File* file, const PageId pageNo)
+{
+	std::shared_ptr<std::promise<Page*> > promise(new std::promise<Page*>());
+	readPageAsync(file, pageNo, [promise, file, pageNo](const BufStatus status, Page* page) {
+		switch(status)
+		{
+			case BufStatus::OK:
+				promise->set_value(page);
+				break;
+			case BufStatus::BUFFER_EXCEEDED:
+				promise->set_exception(std::make_exception_ptr(BufferExceededException()));
+				break;
+			case BufStatus::INVALID_PAGE:
+				promise->set_exception(std::make_exception_ptr(InvalidPageException(pageNo, file->filename())));
+				break;
+			default:
+				promise->set_exception(std::make_exception_ptr(FileIOException(file->filename(), EIO)));
+				break;
+		}
+	});
+	return promise->get_future();
+}
+
+void BufMgr::submitIo()
+{
+	if(ioEngine)
+	{
+		ioEngine->submit();
+	}
+}
+
+void BufMgr::enableReadAhead(const ReadAheadConfig& config)
+{
+	readAheadConfig = config;
+	readAheadConfig.maxPages = std::max<std::uint32_t>(readAheadConfig.maxPages, 1);
+	readAheadConfig.initialPages = std::min(std::max<std::uint32_t>(readAheadConfig.initialPages, 1),
+		readAheadConfig.maxPages);
+	readAheadConfig.maxStride = std::max<std::uint32_t>(readAheadConfig.maxStride, 1);
+	enableAsyncIo();
+	readAheadEnabled = true;
+}
+
+void BufMgr::readAhead(File* file, const PageId pageNo)
+{
+	std::vector<PageId> window;
+	{
+		ReadAheadShard& shard = readAheadShards[file->id() % READ_AHEAD_SHARDS];
+		std::lock_guard<std::mutex> guard(shard.latch);
+		ReadAheadState& state = shard.states[file->id()];
+		const std::int64_t delta = (std::int64_t)pageNo - (std::int64_t)state.lastPage;
+		//Pinning the same page again says nothing about the run
+		if(delta == 0)
+		{
+			return;
+		}
+		const bool known = state.lastPage != Page::INVALID_NUMBER;
+		const std::int64_t distance = delta < 0 ? -delta : delta;
+		state.lastPage = pageNo;
+		//Sequential runs are taken for one after two reads, strided ones after
+		//three
+		if(!known || delta != (state.stride != 0 ? state.stride : 1))
+		{
+			state.stride = known && distance <= readAheadConfig.maxStride ? delta : 0;
+			state.windowPages = 0;
+			return;
+		}
+		state.stride = delta;
+
+		std::int64_t start;
+		//A window evicts pages for itself, so it takes no more than a quarter of the pool
+		const std::uint32_t maxPages = std::min(readAheadConfig.maxPages, std::max<std::uint32_t>(numBufs / 4, 1));
+		if(state.windowPages == 0)
+		{
+			state.windowPages = std::min(readAheadConfig.initialPages, maxPages);
+			start = pageNo + delta;
+		}
+		else if(delta > 0 ? (std::int64_t)pageNo >= state.trigger : (std::int64_t)pageNo <= state.trigger)
+		{
+			//Ramp up quickly while the window is small, as Linux does
+			std::uint32_t next = state.windowPages < maxPages / 16 ? 4 * state.windowPages : 2 * state.windowPages;
+			state.windowPages = std::min(next, maxPages);
+			start = state.windowEnd;
+		}
+		else
+		{
+			return;
+		}
+		for(std::uint32_t k = 0; k < state.windowPages; k++)
+		{
+			const std::int64_t next = start + k * delta;
+			if(next <= (std::int64_t)Page::INVALID_NUMBER || next > (std::int64_t)UINT32_MAX)
+			{
+				break;
+			}
+			window.push_back((PageId)next);
+		}
+		state.trigger = start;
+		state.windowEnd = start + (std::int64_t)state.windowPages * delta;
+	}
+
+	//Pages past the end of the file fail to read and are dropped again
+	try
+	{
+		for(std::size_t k = 0; k < window.size(); k++)
+		{
+			if(!prefetchPage(file, window[k]))
+			{
+				break;
+			}
+		}
+	}
+	catch (...)
+	{
+		//A read failed to queue, the rest of the run is read on demand
+	}
+	ioEngine->submit();
+}
+
+bool BufMgr::prefetchPage(File* file, const PageId pageNo)
+{
+	BufHashPartition& partition = partitionFor(file, pageNo);
+	FrameId frameNo;
+	{
+		std::lock_guard<std::mutex> partitionGuard(partition.latch);
+		if(partition.table->tryLookup(file, pageNo, frameNo))
+		{
+			return true;
+		}
+	}
+	//Frames are taken as for a miss, except from the pages read ahead before,
+	//which are still to be read
+	bool claimed = popFreeFrame(frameNo);
+	while(!claimed && policy->pickVictim(frameNo, prefetchEvictable))
+	{
+		claimed = claimFrame(frameNo);
+	}
+	if(!claimed)
+	{
+		return false;
+	}
+	{
+		std::unique_lock<std::mutex> partitionGuard(partition.latch);
+		FrameId loadedFrameNo;
+		//Another thread may have read the page in while we were sweeping
+		if(partition.table->tryLookup(file, pageNo, loadedFrameNo))
+		{
+			partitionGuard.unlock();
+			releaseFrame(frameNo);
+			return true;
+		}
+		partition.table->insert(file, pageNo, frameNo);
+		indexFrame(file, pageNo, frameNo);
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		setFrame(frameNo, file, pageNo, FrameState::LOADING | FrameState::PREFETCHED);
+	}
+	ReadCallback ignore = [](const BufStatus, Page*) {};
+	try
+	{
+		file->readPageAsync(*ioEngine, pageNo, &bufPool[frameNo],
+			[this, file, pageNo, frameNo, ignore](std::exception_ptr error) {
+				finishLoad(file, pageNo, frameNo, error, ignore);
+			});
+	}
+	catch (...)
+	{
+		finishLoad(file, pageNo, frameNo, std::current_exception(), ignore);
+		throw;
+	}
+	return true;
+}
+
+void BufMgr::awaitLoad(const FrameId frameNo)
+{
+	//The read may still be queued behind our own back
+	if(ioEngine)
+	{
+		ioEngine->submit();
+	}
+	std::unique_lock<std::mutex> loadGuard(loadLatch);
+	loadDone.wait(loadGuard, [this, frameNo]() { return !hasFlag(frameNo, FrameState::LOADING); });
+}
+
+void BufMgr::awaitWrite(const FrameId frameNo)
+{
+	std::unique_lock<std::mutex> loadGuard(loadLatch);
+	loadDone.wait(loadGuard, [this, frameNo]() { return !hasFlag(frameNo, FrameState::WRITING); });
+}
+
+void BufMgr::finishWrite(const FrameId frameNo)
+{
+	{
+		std::lock_guard<std::mutex> loadGuard(loadLatch);
+		clearFlags(frameNo, FrameState::WRITING);
+	}
+	loadDone.notify_all();
+}
+
+void BufMgr::finishLoad(File* file, const PageId pageNo, const FrameId frameNo, std::exception_ptr error,
+	const ReadCallback& done)
+{
+	const bool prefetched = hasFlag(frameNo, FrameState::PREFETCHED);
+	BufStatus status = BufStatus::OK;
+	if(error)
+	{
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch(InvalidPageException&)
+		{
+			status = BufStatus::INVALID_PAGE;
+		}
+		catch(...)
+		{
+			status = BufStatus::IO_ERROR;
+		}
+		//Nobody else got to pin the page, so it simply goes again
+		BufHashPartition& partition = partitionFor(file, pageNo);
+		std::lock_guard<std::mutex> partitionGuard(partition.latch);
+		partition.table->remove(file, pageNo);
+		unindexFrame(file, pageNo, frameNo);
+		//Whoever waited for the read finds the frame holding no page, still
+		//pinned by us until it is freed below
+		std::lock_guard<BufDesc> frameGuard(bufDescTable[frameNo]);
+		bufDescTable[frameNo].file = NULL;
+		bufDescTable[frameNo].pageNo = Page::INVALID_NUMBER;
+		clearFlags(frameNo, FrameState::VALID);
+	}
+	else if(prefetched)
+	{
+		bufStats.diskreads++;
+		bufStats.readaheads++;
+	}
+	else
+	{
+		bufStats.diskreads++;
+		//Pages read for a ring are not references the policy should rank
+		if(!hasFlag(frameNo, FrameState::IN_RING))
+		{
+			policy->recordLoad(frameNo, file, pageNo);
+		}
+	}
+
+	std::vector<std::function<void()> > waiters;
+	{
+		std::lock_guard<std::mutex> loadGuard(loadLatch);
+		//A page read ahead loses its pin in the same step, so whoever waited
+		//for it finds it unpinned. Both are set, one subtraction clears both.
+		if(prefetched && status == BufStatus::OK)
+		{
+			frameState[frameNo].fetch_sub(FrameState::PIN_ONE | FrameState::LOADING);
+		}
+		else
+		{
+			clearFlags(frameNo, FrameState::LOADING);
+		}
+		std::unordered_map<FrameId, std::vector<std::function<void()> > >::iterator waiting
+			= loadWaiters.find(frameNo);
+		if(waiting != loadWaiters.end())
+		{
+			waiters.swap(waiting->second);
+			loadWaiters.erase(waiting);
+		}
+	}
+	loadDone.notify_all();
+
+	if(status == BufStatus::OK)
+	{
+		if(prefetched)
+		{
+			policy->recordUnpin(frameNo);
+			notifyFrameReleased();
+		}
+		done(status, &bufPool[frameNo]);
+	}
+	else
+	{
+		releaseFrame(frameNo);
+		done(status, NULL);
+	}
+	for(std::size_t i = 0; i < waiters.size(); i++)
+	{
+		waiters[i]();
+	}
+}
+
+void BufMgr::configureEviction(const EvictionConfig& config)
+{
+	stopEvictor();
+	evictionConfig = config;
+	if(evictionConfig.batch == 0)
+	{
+		evictionConfig.batch = 1;
+	}
+	if(evictionConfig.lowWater == 0)
+	{
+		evictionConfig.lowWater = std::max<std::uint32_t>(numBufs / 32, 1);
+	}
+	if(evictionConfig.background)
+	{
+		evictorStop = false;
+		evictor = std::thread(&BufMgr::evictorLoop, this);
+	}
+}
+
+void BufMgr::stopEvictor()
+{
+	{
+		std::lock_guard<std::mutex> guard(evictorLatch);
+		evictorStop = true;
+	}
+	evictorWake.notify_all();
+	if(evictor.joinable())
+	{
+		evictor.join();
+	}
+}
+
+void BufMgr::evictorLoop()
+{
+	std::unique_lock<std::mutex> guard(evictorLatch);
+	while(!evictorStop)
+	{
+		//Misses may notify while we are busy, so wake up now and then anyway
+		evictorWake.wait_for(guard, std::chrono::milliseconds(10),
+			[this]() { return evictorStop || numFree < evictionConfig.lowWater; });
+		if(evictorStop || numFree >= evictionConfig.lowWater)
+		{
+			continue;
+		}
+		guard.unlock();
+		std::uint32_t evicted = 0;
+		try
+		{
+			evicted = evictBatch(evictionConfig.batch, NULL);
+		}
+		catch (...)
+		{
+			//A victim failed to write back and stays in the pool
+		}
+		guard.lock();
+		//Every frame is pinned, back off instead of sweeping again right away
+		if(evicted == 0)
+		{
+			evictorWake.wait_for(guard, std::chrono::milliseconds(10), [this]() { return evictorStop; });
+		}
+	}
+}
+
+void BufMgr::startCleaner(const CleanerConfig& config)
+{
+	if(cleaner.joinable())
+	{
+		return;
+	}
+	cleanerConfig = config;
+	cleanerStop = false;
+	cleaner = std::thread(&BufMgr::cleanerLoop, this);
+}
+
+void BufMgr::stopCleaner()
+{
+	{
+		std::lock_guard<std::mutex> guard(cleanerLatch);
+		cleanerStop = true;
+	}
+	cleanerWake.notify_all();
+	if(cleaner.joinable())
+	{
+		cleaner.join();
+	}
+}
+
+void BufMgr::cleanerLoop()
+{
+	std::unique_lock<std::mutex> guard(cleanerLatch);
+	while(!cleanerStop)
+	{
+		guard.unlock();
+		try
+		{
+			cleanRound();
+		}
+		catch (...)
+		{
+			//A page that failed to write stays dirty, its eviction retries it
+		}
+		guard.lock();
+		cleanerWake.wait_for(guard, std::chrono::milliseconds(cleanerConfig.intervalMs),
+			[this]() { return cleanerStop; });
+	}
+}
+
+std::uint32_t BufMgr::cleanRound()
+{
+	std::uint32_t lookahead = cleanerConfig.lookahead > 0 ? cleanerConfig.lookahead
+		: std::max<std::uint32_t>(numBufs / 8, 1);
+	std::vector<FrameId> upcoming;
+	policy->upcomingVictims(upcoming, lookahead);
+	std::uint32_t written = 0;
+	for (std::size_t i = 0; i < upcoming.size() && written < cleanerConfig.maxPages; i++)
+	{
+		if(cleanFrame(upcoming[i]))
+		{
+			written++;
+			bufStats.cleanerwrites++;
+		}
+	}
+
+	//Then bring the share of dirty frames down to the target
+	std::uint32_t dirtyFrames = 0;
+	for (FrameId i = 0; i < numBufs; i++)
+	{
+		if(hasFlag(i, FrameState::DIRTY))
+		{
+			dirtyFrames++;
+		}
+	}
+	std::uint32_t target = (std::uint32_t)(cleanerConfig.dirtyRatio * numBufs);
+	for (std::uint32_t scanned = 0; scanned < numBufs && dirtyFrames > target
+		&& written < cleanerConfig.maxPages; scanned++)
+	{
+		FrameId frameNo = cleanerCursor;
+		cleanerCursor = (cleanerCursor + 1) % numBufs;
+		if(cleanFrame(frameNo))
+		{
+			written++;
+			bufStats.cleanerwrites++;
+			dirtyFrames--;
+		}
+	}
+	return written;
+}
+
+bool BufMgr::cleanFrame(const FrameId frameNo)
+{
+	BufDesc* frame = &bufDescTable[frameNo];
+	std::uint64_t state = frameState[frameNo];
+	if(!(state & FrameState::DIRTY) || FrameState::pinCount(state) > 0)
+	{
+		return false;
+	}
+	File* file;
+	PageId pageNo;
+	{
+		std::lock_guard<BufDesc> frameGuard(*frame);
+		if(!hasFlag(frameNo, FrameState::VALID))
+		{
+			return false;
+		}
+		file = frame->file;
+		pageNo = frame->pageNo;
+	}
+
+	//Aligned, so a direct file writes it without a bounce copy
+	alignas(File::DIRECT_ALIGNMENT) Page copy;
+	{
+		BufHashPartition& partition = partitionFor(file, pageNo);
+		std::lock_guard<std::mutex> partitionGuard(partition.latch);
+		std::lock_guard<BufDesc> frameGuard(*frame);
+		state = frameState[frameNo];
+		if(!(state & FrameState::VALID) || frame->file != file || frame->pageNo != pageNo
+			|| FrameState::pinCount(state) > 0 || !(state & FrameState::DIRTY) || (state & FrameState::WRITING))
+		{
+			return false;
+		}
+		copy = bufPool[frameNo];
+		//Nobody can pin the page before we let go of the partition, so the
+		//frame is marked before it can be seen clean and evicted
+		setFlags(frameNo, FrameState::WRITING);
+		clearFlags(frameNo, FrameState::DIRTY);
+	}
+	try
+	{
+		file->writePage(copy);
+	}
+	catch (...)
+	{
+		{
+			std::lock_guard<BufDesc> frameGuard(*frame);
+			if(frame->file == file && frame->pageNo == pageNo)
+			{
+				setFlags(frameNo, FrameState::DIRTY);
+			}
+		}
+		finishWrite(frameNo);
+		throw;
+	}
+	finishWrite(frameNo);
+	bufStats.diskwrites++;
+	return true;
+}
+
+void BufMgr::printSelf(void)
+{
+  BufDesc* tmpbuf;
+	int validFrames = 0;
+
+  for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+  	tmpbuf = &(bufDescTable[i]);
+		std::uint64_t state = frameState[i];
+		std::cout << "FrameNo:" << i << " ";
+		if(tmpbuf->file)
+		{
+			std::cout << "file:" << tmpbuf->file->filename() << " ";
+			std::cout << "pageNo:" << tmpbuf->pageNo << " ";
+		}
+		else
+			std::cout << "file:NULL ";
+
+		std::cout << "valid:" << ((state & FrameState::VALID) != 0) << " ";
+		std::cout << "pinCnt:" << FrameState::pinCount(state) << " ";
+		std::cout << "dirty:" << ((state & FrameState::DIRTY) != 0) << "\n";
 
-  	if (tmpbuf->valid == true)
+  	if (state & FrameState::VALID)
     	validFrames++;
   }
 
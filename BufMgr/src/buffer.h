@@ -11,8 +11,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "accessStrategy.h"
 #include "file.h"
-#include "bufHashTbl.h"
+#include "frameState.h"
+#include "frequencySketch.h"
+#include "ioEngine.h"
+#include "pageTable.h"
+#include "pageGuard.h"
+#include "replacementPolicy.h"
 
 namespace badgerdb {
 
@@ -22,196 +39,1027 @@ namespace badgerdb {
 class BufMgr;
 
 /**
-* @brief Class for maintaining information about buffer pool frames
+* @brief Outcome of the non-throwing buffer manager calls
+*/
+enum class BufStatus {
+	/**
+   * The call succeeded
+	 */
+  OK,
+
+	/**
+   * The page is not in the buffer pool
+	 */
+  NOT_FOUND,
+
+	/**
+   * The page is in the buffer pool but not pinned
+	 */
+  NOT_PINNED,
+
+	/**
+   * Every frame in the buffer pool is pinned
+	 */
+  BUFFER_EXCEEDED,
+
+	/**
+   * The page does not exist in the file or is not in use
+	 */
+  INVALID_PAGE,
+
+	/**
+   * The operating system failed to read the page
+	 */
+  IO_ERROR
+};
+
+/**
+* @brief Identity of a buffer pool frame: the page it holds. The rest of the frame's state is in its
+* FrameState word.
+*
+* All bytes zero is the initial state, holding no page with the latch clear, so the buffer manager keeps its
+* descriptors in zeroed memory instead of constructing each one.
 */
 class BufDesc {
 
-	friend class BufMgr;
+	friend class BufMgr;
+
+ private:
+	/**
+   * Pointer to file to which corresponding frame is assigned
+	 */
+  File* file;
+
+	/**
+   * Page within file to which corresponding frame is assigned
+	 */
+  PageId pageNo;
+
+	/**
+   * Spin latch guarding the identity (file, pageNo and the VALID flag) of the frame
+	 */
+  std::atomic_flag latch;
+
+ public:
+	/**
+	 * Acquire the frame latch. Held only for short metadata updates (and the write-back of an evicted page),
+	 * so spinning is cheaper than parking the thread.
+	 */
+  void lock()
+	{
+		while(latch.test_and_set(std::memory_order_acquire))
+			std::this_thread::yield();
+  }
+
+	/**
+	 * Release the frame latch
+	 */
+  void unlock()
+	{
+		latch.clear(std::memory_order_release);
+  }
+};
+
+
+/**
+* @brief One latch-protected slice of the buffer pool hash table. A (file, page) pair always hashes to the
+* same partition, so accesses to pages in different partitions never contend with each other.
+*/
+struct BufHashPartition
+{
+	/**
+   * Latch protecting the table below and the pinning of every frame mapped by it
+	 */
+  std::mutex latch;
+
+	/**
+   * Hash table mapping the (File, page) pairs of this partition to frames
+	 */
+  PageTable *table;
+
+	/**
+   * Keeps neighbouring latches on separate cache lines
+	 */
+  char padding[64];
+};
+
+
+/**
+* @brief Class to maintain statistics of buffer usage
+*/
+struct BufStats
+{
+	/**
+   * Total number of accesses to buffer pool
+	 */
+  std::atomic<int> accesses;
+
+	/**
+   * Number of pages read from disk (including allocs)
+	 */
+  std::atomic<int> diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::atomic<int> diskwrites;
+
+	/**
+   * Number of pages written back by the background cleaner, included in diskwrites
+	 */
+  std::atomic<int> cleanerwrites;
+
+	/**
+   * Number of pages read ahead of readPage(), included in diskreads
+	 */
+  std::atomic<int> readaheads;
+
+	/**
+   * Clear all values
+	 */
+  void clear()
+  {
+		accesses = diskreads = diskwrites = cleanerwrites = readaheads = 0;
+  }
+
+	/**
+   * Constructor of BufStats class
+	 */
+  BufStats()
+  {
+		clear();
+  }
+};
+
+
+/**
+* @brief Settings of the background cleaner
+*/
+struct CleanerConfig
+{
+	/**
+   * Milliseconds between two cleaning rounds
+	 */
+  std::uint32_t intervalMs;
+
+	/**
+   * Most pages written back per round, which caps the write rate at maxPages per interval
+	 */
+  std::uint32_t maxPages;
+
+	/**
+   * Number of upcoming victims checked each round, an eighth of the pool if 0
+	 */
+  std::uint32_t lookahead;
+
+	/**
+   * While more than this fraction of the frames is dirty, the cleaner also writes back pages that are not
+   * about to be evicted
+	 */
+  double dirtyRatio;
+
+	/**
+   * Constructor of CleanerConfig class
+	 */
+  CleanerConfig()
+		: intervalMs(10), maxPages(64), lookahead(0), dirtyRatio(0.25) {}
+};
+
+
+/**
+* @brief Settings of frame eviction
+*/
+struct EvictionConfig
+{
+	/**
+   * The background evictor refills the free-frame list whenever fewer frames than this are free. A thirty
+   * second of the pool if 0.
+	 */
+  std::uint32_t lowWater;
+
+	/**
+   * Number of victims evicted in one pass, by a miss that finds the free-frame list empty or by the
+   * background evictor
+	 */
+  std::uint32_t batch;
+
+	/**
+   * True to evict from a background thread; misses then only evict for themselves if the list runs dry
+	 */
+  bool background;
+
+	/**
+   * Milliseconds a readPage() or allocPage() that finds every frame pinned waits for one to be unpinned
+   * before it fails with BufferExceededException, 0 to fail right away. Each unpin wakes one waiting
+   * allocation. Asynchronous reads never wait.
+	 */
+  std::uint32_t allocTimeoutMs;
+
+	/**
+   * Constructor of EvictionConfig class
+	 */
+  EvictionConfig()
+		: lowWater(0), batch(1), background(false), allocTimeoutMs(0) {}
+};
+
+
+/**
+* @brief Settings of read-ahead
+*
+* Like Linux readahead, a run of reads is detected once readPage() is called on pages n and n + 1 of a file,
+* or three times in a row at the same stride. The next initialPages pages of the run are then read
+* asynchronously, and each time the run reaches the first page of the last window read ahead, the next
+* window follows, four times as large while it is small and twice as large later, up to maxPages.
+*/
+struct ReadAheadConfig
+{
+	/**
+   * Pages in the first window of a run
+	 */
+  std::uint32_t initialPages;
+
+	/**
+   * Most pages in one window
+	 */
+  std::uint32_t maxPages;
+
+	/**
+   * Largest distance between the pages of a strided run, 1 to only detect sequential runs
+	 */
+  std::uint32_t maxStride;
+
+	/**
+   * Constructor of ReadAheadConfig class
+	 */
+  ReadAheadConfig()
+		: initialPages(4), maxPages(32), maxStride(8) {}
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file
+*/
+class BufMgr
+{
+	friend class PageGuard;
+
+ public:
+	/**
+	 * Called once an asynchronous read finishes, with the page pinned if status is OK and NULL otherwise
+	 */
+  typedef std::function<void(const BufStatus status, Page* page)> ReadCallback;
+
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+
+	/**
+   * Number of partitions the hash table is split into
+	 */
+  std::uint32_t numPartitions;
+
+	/**
+   * Partitions of the hash table mapping (File, page) to frame
+	 */
+  BufHashPartition *hashPartitions;
+
+	/**
+   * Array of BufDesc objects to hold the identity of every frame allocation from 'bufPool' (the buffer pool).
+   * Zeroed by calloc(), so only the descriptors of frames in use are ever touched.
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * FrameState words of all frames, indexed like bufDescTable, zeroed by calloc() like it
+	 */
+  std::atomic<std::uint64_t>* frameState;
+
+	/**
+   * Maintains Buffer pool usage statistics
+	 */
+  BufStats bufStats;
+
+	/**
+   * Decides which frame is evicted when a page has to be read in
+	 */
+  ReplacementPolicy* policy;
+
+	/**
+   * Access counts compared on admission, NULL unless enableAdmission() was called
+	 */
+  FrequencySketch* sketch;
+
+	/**
+   * Probationary ring that pages failing admission are read into
+	 */
+  BufferAccessStrategy* admissionWindow;
+
+	/**
+   * Serializes use of admissionWindow, which is shared by all threads
+	 */
+  std::mutex windowLatch;
+
+	/**
+   * Frames holding pages of each file, by file name and then page number, so a file's frames are found
+   * without scanning the pool. The page table tells File objects apart, so a page read through two File
+   * objects of one file is in two frames, both listed here.
+	 */
+  std::unordered_map<std::string, std::multimap<PageId, FrameId> > fileFrames;
+
+	/**
+   * Protects fileFrames. Taken last, after any partition and frame latch.
+	 */
+  std::mutex fileFramesLatch;
+
+	/**
+   * Engine of asynchronous reads, NULL unless enableAsyncIo() was called
+	 */
+  IoEngine* ioEngine;
+
+	/**
+   * Number of asynchronous reads queued before they are submitted without waiting for submitIo()
+	 */
+  std::uint32_t ioQueueDepth;
+
+	/**
+   * Protects the loading flags being cleared and loadWaiters
+	 */
+  std::mutex loadLatch;
+
+	/**
+   * Signalled whenever an asynchronous read or a write-back of a page finishes
+	 */
+  std::condition_variable loadDone;
+
+	/**
+   * Asynchronous reads of pages that were being read in already, retried once that read finishes, by frame
+	 */
+  std::unordered_map<FrameId, std::vector<std::function<void()> > > loadWaiters;
+
+	/**
+   * Frames released since they were first handed out, empty, unpinned and ready to be handed out again,
+   * used as a stack. May hold stale entries for frames the replacement policy handed out in the meantime;
+   * those are skipped when popped.
+	 */
+  std::vector<FrameId> freeFrames;
+
+	/**
+   * Frames from this one up have never been handed out. They are handed out in order once freeFrames is
+   * empty, so a new pool costs nothing per frame.
+	 */
+  FrameId nextUnusedFrame;
+
+	/**
+   * Protects freeFrames, nextUnusedFrame and the inFreeList flags
+	 */
+  std::mutex freeLatch;
+
+	/**
+   * Number of entries in freeFrames plus frames never handed out, readable without the latch
+	 */
+  std::atomic<std::uint32_t> numFree;
+
+	/**
+   * Tells the replacement policy which frames it may propose: unpinned ones not on the free-frame list
+	 */
+  ReplacementPolicy::EvictablePredicate evictable;
+
+	/**
+   * Tells the replacement policy which frames read-ahead may take: evictable ones not holding a page read
+   * ahead that was not read yet
+	 */
+  ReplacementPolicy::EvictablePredicate prefetchEvictable;
+
+	/**
+   * Settings of frame eviction
+	 */
+  EvictionConfig evictionConfig;
+
+	/**
+   * Background thread keeping the free-frame list filled
+	 */
+  std::thread evictor;
+
+	/**
+   * Protects evictorStop
+	 */
+  std::mutex evictorLatch;
+
+	/**
+   * Wakes the evictor up when the free-frame list runs low or it has to stop
+	 */
+  std::condition_variable evictorWake;
+
+	/**
+   * True once the evictor has been asked to stop
+	 */
+  bool evictorStop;
+
+	/**
+   * Background thread writing back dirty pages ahead of eviction
+	 */
+  std::thread cleaner;
+
+	/**
+   * Settings of the running cleaner
+	 */
+  CleanerConfig cleanerConfig;
+
+	/**
+   * Protects cleanerStop
+	 */
+  std::mutex cleanerLatch;
+
+	/**
+   * Wakes the cleaner up early when it has to stop
+	 */
+  std::condition_variable cleanerWake;
+
+	/**
+   * True once the cleaner has been asked to stop
+	 */
+  bool cleanerStop;
+
+	/**
+   * Next frame the cleaner looks at when the pool is too dirty, only used by the cleaner thread
+	 */
+  FrameId cleanerCursor;
+
+	/**
+   * Read-ahead state of a file: the run of reads going on and the last window read ahead for it
+	 */
+  struct ReadAheadState
+	{
+		/**
+	   * Page last read, Page::INVALID_NUMBER before the first read
+		 */
+	  PageId lastPage;
+
+		/**
+	   * Distance from the page read before lastPage to lastPage, 0 if unknown
+		 */
+	  std::int64_t stride;
+
+		/**
+	   * Pages in the last window read ahead, 0 while no run is going on
+		 */
+	  std::uint32_t windowPages;
+
+		/**
+	   * First page of the last window; reading it reads the next window ahead
+		 */
+	  std::int64_t trigger;
+
+		/**
+	   * Page the next window starts at
+		 */
+	  std::int64_t windowEnd;
+
+		/**
+	   * Constructor of ReadAheadState class
+		 */
+	  ReadAheadState()
+			: lastPage(Page::INVALID_NUMBER), stride(0), windowPages(0), trigger(0), windowEnd(0) {}
+	};
+
+	/**
+   * True once enableReadAhead() was called
+	 */
+  bool readAheadEnabled;
+
+	/**
+   * Settings of read-ahead
+	 */
+  ReadAheadConfig readAheadConfig;
+
+	/**
+   * Read-ahead states of the File objects whose id falls into one shard
+	 */
+  struct ReadAheadShard
+	{
+		/**
+	   * Protects states. Never held while reading ahead.
+		 */
+	  std::mutex latch;
+
+		/**
+	   * Read-ahead state of every File object read through readPage(), by File::id()
+		 */
+	  std::unordered_map<std::uint32_t, ReadAheadState> states;
+	};
+
+	/**
+   * Number of shards read-ahead states are spread over
+	 */
+  static const std::uint32_t READ_AHEAD_SHARDS = 16;
+
+	/**
+   * Read-ahead states, sharded so scans of different files do not contend
+	 */
+  ReadAheadShard readAheadShards[READ_AHEAD_SHARDS];
+
+	/**
+   * Protects frameReleases. Taken last, after any other latch.
+	 */
+  std::mutex allocLatch;
+
+	/**
+   * Signalled, one waiter at a time, when a frame is unpinned or freed while allocations wait for one
+	 */
+  std::condition_variable frameReleased;
+
+	/**
+   * Number of frames unpinned or freed while allocations were waiting
+	 */
+  std::uint64_t frameReleases;
+
+	/**
+   * Number of allocations waiting for a frame, readable without the latch
+	 */
+  std::atomic<std::uint32_t> allocWaiters;
+
+	/**
+	 * Returns the hash table partition responsible for the given page.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  BufHashPartition& partitionFor(const File* file, const PageId pageNo);
+
+	/**
+	 * The evictable predicate handed to the replacement policy: the frame is unpinned, not on the free-frame
+	 * list and not being written back.
+	 *
+	 * @param context	The frameState array
+	 * @param frameNo	Frame number
+	 */
+  static bool frameEvictable(const void* context, const FrameId frameNo);
+
+	/**
+	 * The evictable predicate read-ahead hands to the replacement policy: like frameEvictable(), and the frame
+	 * does not hold a page read ahead and not read since, so one window never pushes out the last.
+	 *
+	 * @param context	The frameState array
+	 * @param frameNo	Frame number
+	 */
+  static bool framePrefetchEvictable(const void* context, const FrameId frameNo);
+
+	/**
+	 * Try to take a frame the replacement policy picked as victim. A valid frame is written back if
+	 * dirty, through cleanFrame() so no partition latch is held during the write, and removed from the hash
+	 * table. On success the frame is cleared and left with a pin count of one, which reserves it for the
+	 * caller.
+	 *
+	 * @param frameNo	Frame number of the candidate frame
+	 * @return 				True if the frame was claimed, false if another thread got to it first
+	 */
+  bool claimFrame(const FrameId frameNo);
+
+	/**
+	 * Adds a frame to the frames of its page's file. Called with the page's partition latch held.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number of the page now in the frame
+	 * @param frameNo	Frame number of the frame
+	 */
+  void indexFrame(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Removes a frame from the frames of its page's file. Called with the page's partition latch held.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number of the page leaving the pool
+	 * @param frameNo	Frame number of the frame
+	 */
+  void unindexFrame(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Removes all pages of the file from the buffer pool in page number order, writing dirty ones out first
+	 * if asked to.
+	 *
+	 * @param file   	File object
+	 * @param writeBack	True to write dirty pages to disk, false to discard them
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void evictFile(const File* file, const bool writeBack);
+
+	/**
+	 * Writes the given pages of one file back together, then evicts their frames with evictPinned(). If the
+	 * write fails, the pages are marked dirty again and stay in the pool.
+	 *
+	 * @param file   	File object the pages belong to, may be NULL if there are no pages
+	 * @param pages  	Pages to write, marked clean and pinned once by the caller
+	 * @param frames 	Frames pinned once by the caller, including those of pages
+	 */
+  void writeAndRelease(File* file, const std::vector<const Page*>& pages, const std::vector<FrameId>& frames);
 
- private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+	 * Drops the caller's pin on a valid frame and evicts its page without writing it, unless someone else
+	 * pinned or dirtied the page in the meantime.
+	 *
+	 * @param frameNo	Frame number of the frame
 	 */
-  File* file;
+  void evictPinned(const FrameId frameNo);
 
 	/**
-   * Page within file to which corresponding frame is assigned
+	 * Waits until no asynchronous read into the frame is in flight, submitting queued reads first.
+	 *
+	 * @param frameNo	Frame number of the frame
 	 */
-  PageId pageNo;
+  void awaitLoad(const FrameId frameNo);
+
+	/**
+	 * Waits until no write-back of the page in the frame is in flight.
+	 *
+	 * @param frameNo	Frame number of the frame
+	 */
+  void awaitWrite(const FrameId frameNo);
 
 	/**
-   * Frame number of the frame, in the buffer pool, being used
+	 * Ends a write-back started by setting WRITING, waking whoever waits for it.
+	 *
+	 * @param frameNo	Frame number of the frame
 	 */
-  FrameId	frameNo;
+  void finishWrite(const FrameId frameNo);
 
 	/**
-   * Number of times this page has been pinned
+	 * Completes an asynchronous read: reports the page loaded or takes it back out of the pool, then calls
+	 * done and retries the reads that waited for this one. A page read ahead is unpinned instead of reported
+	 * to the replacement policy, and so is a page read into a ring.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @param frameNo	Frame the page was read into
+	 * @param error  	Null, or the exception the read failed with
+	 * @param done   	Callback of the read
 	 */
-  int pinCnt;
+  void finishLoad(File* file, const PageId pageNo, const FrameId frameNo, std::exception_ptr error,
+									const ReadCallback& done);
 
 	/**
-   * True if page is dirty;  false otherwise
+	 * Tracks a readPage() of a file, hit or miss, and reads the next window of pages ahead if it continues a
+	 * run, so a scan keeps its run through pages that are already resident. Windows take at most a quarter of
+	 * the pool. Read-ahead is only a hint, so failures to read ahead are not reported.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number just pinned
 	 */
-  bool dirty;
+  void readAhead(File* file, const PageId pageNo);
 
 	/**
-   * True if page is valid
+	 * Queues an asynchronous read of a page, unless it is in the pool already. The page goes into a free
+	 * frame, or one the replacement policy evicts as for a miss, but never into one holding another page read
+	 * ahead and not read yet. The page is left unpinned and PREFETCHED once read.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @return 				False if no frame could be had
 	 */
-  bool valid;
+  bool prefetchPage(File* file, const PageId pageNo);
 
 	/**
-   * Has this buffer frame been reference recently
+	 * Puts an empty frame on the free-frame list, unless it already is.
+	 *
+	 * @param frameNo	Frame number of the empty frame
 	 */
-  bool refbit;
+  void pushFreeFrame(const FrameId frameNo);
 
 	/**
-   * Initialize buffer frame for a new user
+	 * Takes a frame off the free-frame list and reserves it (pin count of one). Wakes the background
+	 * evictor if the list runs low.
+	 *
+	 * @param frame   	Frame reference, frame ID of the reserved frame returned via this variable
+	 * @return 					False if the list holds no usable frame
 	 */
-  void Clear()
-	{
-    pinCnt = 0;
-		file = NULL;
-		pageNo = Page::INVALID_NUMBER;
-    dirty = false;
-    refbit = false;
-		valid = false;
-  };
+  bool popFreeFrame(FrameId & frame);
+
+	/**
+	 * Evicts up to count victims in one pass and puts them on the free-frame list.
+	 *
+	 * @param count   	Number of victims to evict
+	 * @param frame   	If not NULL, the first victim is kept reserved for the caller instead and returned here
+	 * @return 					Number of frames freed, including the one kept
+	 */
+  std::uint32_t evictBatch(const std::uint32_t count, FrameId* frame);
+
+	/**
+	 * Body of the evictor thread
+	 */
+  void evictorLoop();
+
+	/**
+	 * Stops the background evictor if it runs and waits for it to finish its pass.
+	 */
+  void stopEvictor();
+
+	/**
+	 * Hand a frame returned by allocBuf back to the pool without using it.
+	 *
+	 * @param frameNo	Frame number of the reserved frame
+	 */
+  void releaseFrame(const FrameId frameNo);
+
+	/**
+	 * Forgets the page in a frame: its identity, pins, usage, dirty and ring flags. Called with the frame
+	 * latch held.
+	 */
+  void clearFrame(const FrameId frameNo);
 
 	/**
-	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame
-	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * Assigns a frame to a page, pinned once, valid and clean, with the given flags set. Called with the frame
+	 * latch held.
 	 *
-	 * @param filePtr	File object
-	 * @param pageNum	Page number in the file
+	 * @param frameNo	Frame number
+	 * @param file		File of the page
+	 * @param pageNo	Page number in the file
+	 * @param flags		FrameState flags to set as well
+	 */
+  void setFrame(const FrameId frameNo, File* file, const PageId pageNo, const std::uint64_t flags);
+
+	/**
+	 * Pins an empty, unpinned frame once. Fails if the frame holds a page or is pinned.
+	 */
+  bool tryPinEmpty(const FrameId frameNo);
+
+	/**
+	 * Returns true if the frame has any of the given FrameState flags set.
 	 */
-  void Set(File* filePtr, PageId pageNum)
+  bool hasFlag(const FrameId frameNo, const std::uint64_t flags) const
 	{
-		file = filePtr;
-    pageNo = pageNum;
-    pinCnt = 1;
-    dirty = false;
-    valid = true;
-    refbit = true;
-  }
+		return (frameState[frameNo].load() & flags) != 0;
+	}
 
-  void Print()
+	/**
+	 * Returns the pin count of the frame.
+	 */
+  std::uint32_t pinCount(const FrameId frameNo) const
 	{
-		if(file)
-		{
-			std::cout << "file:" << file->filename() << " ";
-			std::cout << "pageNo:" << pageNo << " ";
-		}
-		else
-			std::cout << "file:NULL ";
-
-		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
-  }
+		return FrameState::pinCount(frameState[frameNo].load());
+	}
 
 	/**
-   * Constructor of BufDesc class
+	 * Sets FrameState flags of the frame.
 	 */
-  BufDesc()
+  void setFlags(const FrameId frameNo, const std::uint64_t flags)
 	{
-  	Clear();
-  }
-};
+		frameState[frameNo].fetch_or(flags);
+	}
 
+	/**
+	 * Clears FrameState flags of the frame.
+	 */
+  void clearFlags(const FrameId frameNo, const std::uint64_t flags)
+	{
+		frameState[frameNo].fetch_and(~flags);
+	}
 
-/**
-* @brief Class to maintain statistics of buffer usage
-*/
-struct BufStats
-{
 	/**
-   * Total number of accesses to buffer pool
+	 * Adds a pin to the frame. Frames holding a page are only pinned with the latch of their partition held.
 	 */
-  int accesses;
+  void pinFrame(const FrameId frameNo)
+	{
+		frameState[frameNo].fetch_add(FrameState::PIN_ONE);
+	}
 
 	/**
-   * Number of pages read from disk (including allocs)
+	 * Adds a pin to a mapped frame in one atomic step, unless an asynchronous read into it is in flight.
+	 * Called with the latch of the frame's partition held.
+	 *
+	 * @return True if the frame was pinned, false if the page is still loading
 	 */
-  int diskreads;
+  bool pinIfLoaded(const FrameId frameNo);
 
 	/**
-   * Number of pages written back to disk
+	 * Pins the given page in a frame, reading it from the file on a miss. A missed page is published LOADING
+	 * before it is read, so the read holds no latch and other misses on the page wait for it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param frameNo Frame the page is pinned in, only set when the call returns BufStatus::OK
+	 * @param strategy Access strategy whose ring a missed page is read into, NULL for the main pool
+	 * @param ioError Set to the exception the file raised when the call returns BufStatus::IO_ERROR, may be NULL
+	 * @return 				BufStatus::OK, BufStatus::BUFFER_EXCEEDED, BufStatus::INVALID_PAGE or BufStatus::IO_ERROR
 	 */
-  int diskwrites;
+  BufStatus pinPage(File* file, const PageId pageNo, FrameId& frameNo, BufferAccessStrategy* strategy,
+		std::exception_ptr* ioError);
 
 	/**
-   * Clear all values
+	 * Pins the given page like pinPage() and returns the pointer to it, reading ahead if enabled. Shared by
+	 * readPage() and tryReadPage().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, only set when the call returns BufStatus::OK
+	 * @param strategy Access strategy confining a miss to its ring of frames, NULL to use the whole pool
+	 * @param ioError Set to the exception the file raised when the call returns BufStatus::IO_ERROR, may be NULL
+	 * @return 				BufStatus::OK, BufStatus::BUFFER_EXCEEDED, BufStatus::INVALID_PAGE or BufStatus::IO_ERROR
 	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
+  BufStatus fetchPage(File* file, const PageId pageNo, Page*& page, BufferAccessStrategy* strategy,
+		std::exception_ptr* ioError);
 
 	/**
-   * Constructor of BufStats class
+	 * Reports a pin of an already resident page. Accesses without a strategy take the frame out of any ring
+	 * and count as references for the replacement policy; accesses through a strategy do neither.
+	 *
+	 * @param frameNo Frame the page is pinned in
+	 * @param strategy Access strategy of the access, NULL for none
 	 */
-  BufStats()
-  {
-		clear();
-  }
-};
+  void recordHit(const FrameId frameNo, const BufferAccessStrategy* strategy);
 
+	/**
+	 * Allocates a new page in the file and pins it in a frame.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number assigned to the new page, returned via this reference
+	 * @param frameNo Frame the page is pinned in, returned via this reference
+	 * @param strategy Access strategy whose ring the page is put in, NULL for the main pool
+	 * @throws BufferExceededException If every frame in the buffer pool is pinned
+	 */
+  void pinNewPage(File* file, PageId& pageNo, FrameId& frameNo, BufferAccessStrategy* strategy);
 
-/**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file
-*/
-class BufMgr
-{
- private:
 	/**
-   * Current position of clockhand in our buffer pool
+	 * Drops one pin on a frame known to be pinned, without a hash table lookup. Only pins are taken under
+	 * the partition latch; dropping one outside it cannot let an evictor see a pinned frame as free.
+	 *
+	 * @param frameNo	Frame to unpin
+	 * @param dirty		True if the page needs to be marked dirty
+	 * @return 				False if the frame was not pinned
 	 */
-  FrameId clockHand;
+  bool unpinFrame(const FrameId frameNo, const bool dirty);
 
 	/**
-   * Number of frames in the buffer pool
+	 * Allocate a free frame without throwing when the pool is full. The frame is returned reserved (pin count
+	 * of one) and invalid; the caller either Set()s it for a page or gives it back through releaseFrame().
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return 					False if every frame in the buffer pool is pinned
 	 */
-  std::uint32_t numBufs;
+  bool tryAllocBuf(FrameId & frame);
+
+	/**
+	 * Allocates several frames at once: empty ones first, then victims claimed in one sweep of the
+	 * replacement policy. The frames are returned reserved, as by tryAllocBuf().
+	 *
+	 * @param count   	Number of frames wanted
+	 * @param frames   	Frames allocated so far, appended to until it holds count frames
+	 * @return 					False if every other frame in the buffer pool is pinned before count are allocated
+	 */
+  bool tryAllocBufs(const std::uint32_t count, std::vector<FrameId>& frames);
 
 	/**
-   * Hash table mapping (File, page) to frame
+	 * Allocate a frame for an access through a strategy. The next frame of the ring is recycled if the ring
+	 * still owns it; otherwise a frame is allocated from the pool and takes its place in the ring. BULKREAD
+	 * rings leave dirty frames to the pool rather than write them back. The frame is returned reserved, as
+	 * by tryAllocBuf().
+	 *
+	 * @param strategy	Access strategy owning the ring
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return 					False if every frame in the buffer pool is pinned
 	 */
-  BufHashTbl *hashTable;
+  bool tryAllocRingBuf(BufferAccessStrategy* strategy, FrameId & frame);
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 * Returns the ring slot of a strategy to use for the next miss and advances past it.
+	 *
+	 * @param strategy	Access strategy owning the ring
 	 */
-  BufDesc *bufDescTable;
+  FrameId& nextRingSlot(BufferAccessStrategy* strategy);
 
 	/**
-   * Maintains Buffer pool usage statistics
+	 * Try to claim the frame in a ring slot for the next page of the ring.
+	 *
+	 * @param strategy	Access strategy owning the ring
+	 * @param frameNo		Frame in the slot, may be BufferAccessStrategy::NO_FRAME
+	 * @return 					False if the slot is empty, the ring no longer owns the frame, or it is in use
 	 */
-  BufStats bufStats;
+  bool reuseRingFrame(const BufferAccessStrategy* strategy, const FrameId frameNo);
+
+	/**
+	 * Allocate a frame for a missed page, subject to TinyLFU admission. The page is admitted to the main pool
+	 * only if it was accessed more often recently than the victim it would replace; otherwise it is read
+	 * into the probationary window, whose frames are recycled among themselves. A window page that is
+	 * accessed again is promoted to the main pool like any ring page. The frame is returned reserved, as by
+	 * tryAllocBuf().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param frame   Frame reference, frame ID of allocated frame returned via this variable
+	 * @param inWindow Set to true if the frame belongs to the window
+	 * @return 				False if every frame in the buffer pool is pinned
+	 */
+  bool tryAllocAdmitted(const File* file, const PageId pageNo, FrameId & frame, bool & inWindow);
+
+	/**
+	 * Writes back the page in a frame if it is dirty and unpinned, leaving it in the pool clean. The page is
+	 * copied under the latches and the copy written with the frame marked WRITING, so readers of the page
+	 * are not held up and the frame is only evicted once the write is done.
+	 *
+	 * @param frameNo	Frame to clean
+	 * @return 				True if the page was written back
+	 */
+  bool cleanFrame(const FrameId frameNo);
+
+	/**
+	 * One round of the cleaner: writes back the dirty upcoming victims, then more dirty pages while the pool
+	 * is dirtier than the target ratio, up to the configured number of pages.
+	 *
+	 * @return 				Number of pages written back
+	 */
+  std::uint32_t cleanRound();
+
+	/**
+	 * Body of the cleaner thread
+	 */
+  void cleanerLoop();
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Retries an allocation that found every frame pinned each time a frame is unpinned or freed, until it
+	 * succeeds or EvictionConfig::allocTimeoutMs passed. Returns false right away if no timeout is set.
+	 *
+	 * @param tryAlloc	Allocation to retry, returns false if every frame is pinned
+	 * @return 					True once tryAlloc succeeded, false on timeout
+	 */
+  bool awaitFrame(const std::function<bool()>& tryAlloc);
+
+	/**
+	 * Wakes one allocation waiting for a frame, if any. Called after a frame was unpinned or freed.
 	 */
-  void advanceClock();
+  void notifyFrameReleased();
 
 	/**
-	 * Allocate a free frame.
+	 * Allocate a free frame, waiting for one as configured if every frame is pinned. The frame is returned
+	 * reserved (pin count of one) and invalid; the caller either Set()s it for a page or gives it back
+	 * through releaseFrame().
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
   void allocBuf(FrameId & frame);
 
+	/**
+   * Length of the mapping bufPool lies at the start of, a multiple of ARENA_ALIGNMENT
+	 */
+  std::size_t arenaBytes;
+
+	/**
+   * True if the arena is backed by reserved huge pages (MAP_HUGETLB), false if by normal pages that the
+   * kernel may back by transparent huge pages
+	 */
+  bool arenaHugeTlb;
+
+	/**
+   * Background thread faulting the arena in ahead of use
+	 */
+  std::thread prefaulter;
+
+	/**
+   * True once the prefaulter has been asked to stop
+	 */
+  std::atomic<bool> prefaultStop;
+
+	/**
+	 * Maps an ARENA_ALIGNMENT aligned arena for all frames into bufPool. Tries reserved huge pages first, then
+	 * normal pages advised to be backed by transparent huge pages.
+	 *
+	 * @throws std::bad_alloc If no memory can be mapped
+	 */
+  void mapArena();
+
+	/**
+	 * Faults the arena in one ARENA_ALIGNMENT chunk at a time, until done or asked to stop. Gives up quietly
+	 * on kernels without MADV_POPULATE_WRITE.
+	 */
+  void prefaultArena();
+
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Actual buffer pool from which frames are allocated, one Page per frame in a single contiguous arena
 	 */
   Page* bufPool;
 
 	/**
-   * Constructor of BufMgr class
+   * Alignment and granularity of the frame arena, the size of a huge page
+	 */
+  static const std::size_t ARENA_ALIGNMENT = 2 * 1024 * 1024;
+
+	/**
+   * Default number of hash table partitions
+	 */
+  static const std::uint32_t DEFAULT_PARTITIONS = 16;
+
+	/**
+   * Constructor of BufMgr class. All public methods may be called concurrently from several threads.
+	 *
+	 * @param bufs				Number of frames in the buffer pool
+	 * @param partitions	Number of latch-protected partitions to split the hash table into. Threads only
+	 * 										contend on the hit path when they access pages of the same partition.
+	 * @param replacement	Replacement policy created for bufs frames, CLOCK if NULL. The buffer manager takes
+	 * 										ownership of it.
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, std::uint32_t partitions = DEFAULT_PARTITIONS, ReplacementPolicy* replacement = NULL);
 
 	/**
    * Destructor of BufMgr class
@@ -226,8 +1074,62 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy Access strategy confining a miss to its ring of frames, NULL to use the whole pool
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Same as readPage(), but reports failures through the returned status instead of throwing, so a miss
+	 * never costs an exception.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, only set when the call returns BufStatus::OK
+	 * @param strategy Access strategy confining a miss to its ring of frames, NULL to use the whole pool
+	 * @return 				BufStatus::OK, BufStatus::BUFFER_EXCEEDED, BufStatus::INVALID_PAGE, or BufStatus::IO_ERROR if
+	 * 								reading the page or writing back the frame's previous page failed
+	 */
+  BufStatus tryReadPage(File* file, const PageId PageNo, Page*& page, BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads a set of pages of one file and pins each of them, like readPage() does for every page. Pages
+	 * already in the pool are pinned in one pass; frames for all missing pages are allocated together, and
+	 * the missing pages are read in page number order, runs of adjacent pages with one vectored read each.
+	 * Either every page is pinned or, if anything fails, none is. Misses do not go through TinyLFU admission.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers in the file to be read, in any order. A page listed twice is pinned twice.
+	 * @param pages  	Receives the pinned pages, one per page number
+	 * @throws BufferExceededException If the pool has too few unpinned frames for the missing pages
+	 * @throws InvalidPageException If a page does not exist in the file
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages);
+
+	/**
+	 * Reads the given page like readPage() and returns a guard giving read-only access to it. The page is
+	 * unpinned when the guard is destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param strategy Access strategy confining a miss to its ring of frames, NULL to use the whole pool
+	 * @return 				Guard holding the pin on the page
+	 * @throws BufferExceededException If every frame in the buffer pool is pinned
+	 * @throws InvalidPageException If the page does not exist in the file
+	 */
+  ReadPageGuard readPageGuarded(File* file, const PageId PageNo, BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads the given page like readPage() and returns a guard giving write access to it. The page is marked
+	 * dirty if it is accessed through the guard and unpinned when the guard is destroyed.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param strategy Access strategy confining a miss to its ring of frames, NULL to use the whole pool
+	 * @return 				Guard holding the pin on the page
+	 * @throws BufferExceededException If every frame in the buffer pool is pinned
+	 * @throws InvalidPageException If the page does not exist in the file
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  WritePageGuard writePageGuarded(File* file, const PageId PageNo, BufferAccessStrategy* strategy = NULL);
 
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
@@ -239,6 +1141,27 @@ class BufMgr
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
+	/**
+	 * Same as unPinPage(), but reports failures through the returned status instead of throwing.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+	 * @return 				BufStatus::OK, BufStatus::NOT_FOUND or BufStatus::NOT_PINNED
+	 */
+  BufStatus tryUnpin(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Unpins a set of pages of one file, e.g. those pinned by readPages(). Every page is unpinned even if
+	 * one of them fails.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers, a page listed twice is unpinned twice
+	 * @param dirty		True if the pages need to be marked dirty
+   * @throws  PageNotPinnedException If a page is not pinned, after all others were unpinned
+	 */
+  void unPinPages(File* file, const std::vector<PageId>& pageNos, const bool dirty);
+
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
 	 * The newly allocated page is also assigned a frame in the buffer pool.
@@ -246,23 +1169,47 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param strategy Access strategy whose ring the page is put in, NULL to use the whole pool
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page, BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Allocates a new page like allocPage() and returns a guard giving write access to it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param strategy Access strategy whose ring the page is put in, NULL to use the whole pool
+	 * @return 				Guard holding the pin on the page
+	 * @throws BufferExceededException If every frame in the buffer pool is pinned
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page);
+  WritePageGuard allocPageGuarded(File* file, PageId &PageNo, BufferAccessStrategy* strategy = NULL);
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
+	 * Writes out all dirty pages of the file to disk and syncs the file, so they are durable once it returns.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
    * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * @throws FileIOException If the file could not be synced
 	 */
   void flushFile(const File* file);
 
+	/**
+	 * Removes all pages of the file from the buffer pool without writing them to disk, e.g. before the file
+	 * is deleted. Changes made to the pages in the pool are lost.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void dropFile(const File* file);
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * A page not in the buffer pool is left in the file.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
@@ -270,10 +1217,117 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Turns on TinyLFU admission for pages missed by readPage() without an access strategy. Must be called
+	 * before the buffer manager is shared between threads.
+	 *
+	 * @param windowFrames	Frames in the probationary window, 1% of the pool if 0. Capped at an eighth of it.
+	 */
+  void enableAdmission(const std::uint32_t windowFrames = 0);
+
+	/**
+	 * Turns on asynchronous reads through an io_uring, or synchronous ones on kernels without it. Must be
+	 * called before the buffer manager is shared between threads.
+	 *
+	 * @param queueDepth	Reads in flight at most, and reads queued before they are submitted on their own
+	 */
+  void enableAsyncIo(const std::uint32_t queueDepth = 64);
+
+	/**
+	 * Turns on read-ahead: readPage() detects sequential and strided runs of reads in each file and reads the
+	 * pages the run will get to next asynchronously, into free frames or frames the replacement policy
+	 * evicts as for a miss. A window never evicts pages read ahead and not read yet, nor takes more than a
+	 * quarter of the pool. Turns on asynchronous I/O as well. Must be called before the buffer manager is
+	 * shared between threads.
+	 *
+	 * @param config	Window sizes and the largest stride detected
+	 */
+  void enableReadAhead(const ReadAheadConfig& config = ReadAheadConfig());
+
+	/**
+	 * Reads a page asynchronously and pins it. A page already in the pool is pinned and reported right away;
+	 * a missing page is queued for reading, and reported from the I/O thread once it arrives. Queued reads
+	 * go to the kernel together on submitIo(), or on their own once queueDepth of them are queued. Misses
+	 * do not go through TinyLFU admission.
+	 *
+	 * The callback must not wait for other reads of this buffer manager, including through readPage() on a
+	 * page being read asynchronously. Without enableAsyncIo() the read happens synchronously.
+	 *
+	 * Failures never throw, with or without enableAsyncIo(); they are reported to the callback, with
+	 * BufStatus::IO_ERROR if reading the page or writing back the frame's previous page failed.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @param done   	Called once the page is pinned or the read failed
+	 */
+  void readPageAsync(File* file, const PageId pageNo, const ReadCallback& done);
+
+	/**
+	 * Reads a page asynchronously and pins it, like readPageAsync() with a callback.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @return 				The page once it is pinned. Getting it rethrows BufferExceededException,
+	 * 								InvalidPageException or FileIOException if the read failed.
+	 */
+  std::future<Page*> readPageAsync(File* file, const PageId pageNo);
+
+	/**
+	 * Hands all queued asynchronous reads to the kernel in one call.
+	 */
+  void submitIo();
+
+	/**
+	 * Sets how frames are evicted, and starts or stops the background evictor accordingly. Empty frames are
+	 * always handed out from the free-frame list first. Must not be called while other threads use the buffer
+	 * manager.
+	 *
+	 * @param config	Batch size, low-water mark and whether to evict in the background
+	 */
+  void configureEviction(const EvictionConfig& config);
+
+	/**
+	 * Starts a background thread that writes back unpinned dirty pages before they are evicted, so misses
+	 * rarely have to write back their victim. Does nothing if the cleaner is already running.
+	 *
+	 * @param config	Rate and dirty ratio targets of the cleaner
+	 */
+  void startCleaner(const CleanerConfig& config = CleanerConfig());
+
+	/**
+	 * Stops the background cleaner and waits for it to finish its round. Called by the destructor.
+	 */
+  void stopCleaner();
+
+	/**
    * Print member variable values.
 	 */
   void  printSelf();
 
+	/**
+	 * Faults in all memory of the buffer pool, so the first use of a frame does not pay for the page fault.
+	 * Frames are usable throughout; the pool needs no initialization, since every frame is overwritten when
+	 * a page is read or allocated into it. Does nothing if the pool is being faulted in already.
+	 *
+	 * @param background	True to return at once and fault the pool in on a background thread
+	 */
+  void prefaultPool(const bool background = true);
+
+	/**
+	 * Returns the number of bytes of memory mapped for the frames.
+	 */
+  std::size_t arenaSize() const
+	{
+		return arenaBytes;
+	}
+
+	/**
+	 * Returns true if the frames lie in reserved huge pages.
+	 */
+  bool arenaOnHugeTlb() const
+	{
+		return arenaHugeTlb;
+	}
+
 	/**
    * Get buffer pool usage statistics
 	 */
@@ -0,0 +1,131 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "clockPolicy.h"
+
+namespace badgerdb {
+
+ClockPolicy::ClockPolicy(const std::uint32_t frames, const std::uint32_t maxCount)
+	: numFrames(frames), clockHand(frames - 1),
+		maxUsage((std::uint8_t)(maxCount < 1 ? 1 : (maxCount > FrameState::MAX_USAGE ? FrameState::MAX_USAGE : maxCount))),
+		ownStates(true)
+{
+	states = new std::atomic<std::uint64_t>[frames];
+	for (FrameId i = 0; i < frames; i++)
+	{
+		states[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+ClockPolicy::~ClockPolicy()
+{
+	if(ownStates)
+	{
+		delete [] states;
+	}
+}
+
+void ClockPolicy::attachFrameStates(std::atomic<std::uint64_t>* frameStates)
+{
+	if(ownStates)
+	{
+		delete [] states;
+	}
+	states = frameStates;
+	ownStates = false;
+}
+
+//Move the hand of the clock to the next frame
+FrameId ClockPolicy::advanceClock()
+{
+  //current index % bufs - 1
+  return (clockHand.fetch_add(1) + 1)%numFrames;
+}
+
+void ClockPolicy::recordAccess(const FrameId frameNo)
+{
+	//Saturating increment; a hot page mostly finds its count at the maximum
+	//already and gets away with a plain load
+	std::uint64_t state = states[frameNo].load(std::memory_order_relaxed);
+	while(FrameState::usage(state) < maxUsage
+				&& !states[frameNo].compare_exchange_weak(state, state + FrameState::USAGE_ONE, std::memory_order_relaxed))
+	{
+	}
+}
+
+void ClockPolicy::recordLoad(const FrameId frameNo, const File* file, const PageId pageNo)
+{
+	//The rest of the word belongs to the buffer manager and changes under us
+	std::uint64_t state = states[frameNo].load(std::memory_order_relaxed);
+	while(!states[frameNo].compare_exchange_weak(state, (state & ~FrameState::USAGE_MASK) | FrameState::USAGE_ONE,
+																							 std::memory_order_relaxed))
+	{
+	}
+}
+
+void ClockPolicy::recordUnpin(const FrameId frameNo)
+{
+}
+
+void ClockPolicy::recordEviction(const FrameId frameNo, const File* file, const PageId pageNo)
+{
+	states[frameNo].fetch_and(~FrameState::USAGE_MASK, std::memory_order_relaxed);
+}
+
+void ClockPolicy::recordFree(const FrameId frameNo)
+{
+	states[frameNo].fetch_and(~FrameState::USAGE_MASK, std::memory_order_relaxed);
+}
+
+bool ClockPolicy::pickVictim(FrameId& frameNo, const EvictablePredicate& evictable)
+{
+  //Keep looking for an unpinned frame, if a whole sweep found every page in
+	//memory pinned, give up
+	std::uint32_t ticks = 0;
+	std::uint32_t numPinnedPages = 0;
+  while(true){
+		FrameId currFrame = advanceClock();
+		if(!evictable(currFrame)){
+			numPinnedPages++;
+		}
+		else{
+			//A frame whose count is used up is the victim, any other loses one
+			//unit. If another sweeper, a pin or the buffer manager changed the
+			//word meanwhile, the frame is simply passed over this time.
+			std::uint64_t state = states[currFrame].load(std::memory_order_relaxed);
+			if(FrameState::usage(state) == 0){
+				frameNo = currFrame;
+				return true;
+			}
+			states[currFrame].compare_exchange_strong(state, state - FrameState::USAGE_ONE, std::memory_order_relaxed);
+		}
+
+		if(++ticks == numFrames){
+			//If all pages seen during the last sweep were pinned
+			if(numPinnedPages == numFrames){
+				return false;
+			}
+			ticks = 0;
+			numPinnedPages = 0;
+		}
+  }
+}
+
+void ClockPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+	FrameId hand = clockHand.load();
+	for (std::uint32_t i = 1; i <= count && i <= numFrames; i++)
+	{
+		FrameId frameNo = (hand + i) % numFrames;
+		if(FrameState::usage(states[frameNo].load(std::memory_order_relaxed)) == 0)
+		{
+			frames.push_back(frameNo);
+		}
+	}
+}
+
+}
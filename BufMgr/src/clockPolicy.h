@@ -0,0 +1,113 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "frameState.h"
+#include "replacementPolicy.h"
+
+namespace badgerdb {
+
+/**
+* @brief The CLOCK replacement policy, the buffer manager's default, and its generalization GCLOCK.
+*
+* Every frame has a usage count that goes up by one whenever its page is pinned, up to a maximum. The clock
+* hand sweeps over the frames, decrementing nonzero counts, and stops at the first unpinned frame whose
+* count is already zero. With a maximum of 1 the count is the reference bit of classic CLOCK. A larger
+* maximum lets a page that is pinned over and over survive that many sweeps without another reference,
+* while a page touched once by a scan still goes after one. The hand is advanced atomically, so several
+* threads can sweep at once and each sees a distinct frame per tick.
+*
+* The counts are kept in the usage bits of the buffer manager's FrameState words once it attaches them, so
+* the sweep reads a frame's pin count and usage count from one word. Until then, e.g. when the policy is
+* driven on its own, it keeps words of its own.
+*/
+class ClockPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Current position of clockhand in our buffer pool
+	 */
+  std::atomic<FrameId> clockHand;
+
+	/**
+   * Largest usage count
+	 */
+  std::uint8_t maxUsage;
+
+	/**
+   * FrameState word of every frame, whose usage count tells how many more sweeps its page survives
+	 */
+  std::atomic<std::uint64_t>* states;
+
+	/**
+   * True while states is the policy's own array rather than the buffer manager's
+	 */
+  bool ownStates;
+
+	/**
+   * Advance clock to next frame in the buffer pool
+	 *
+	 * @return 				The frame the clock hand now points to
+	 */
+  FrameId advanceClock();
+
+ public:
+	/**
+   * Constructor of ClockPolicy class
+	 *
+	 * @param frames			Number of frames in the buffer pool
+	 * @param maxCount		Largest usage count, between 1 (CLOCK) and 255
+	 */
+  ClockPolicy(const std::uint32_t frames, const std::uint32_t maxCount = 1);
+
+	/**
+   * Destructor of ClockPolicy class
+	 */
+  ~ClockPolicy();
+
+	/**
+	 * Moves the usage counts into the buffer manager's FrameState words.
+	 */
+  void attachFrameStates(std::atomic<std::uint64_t>* frameStates);
+
+	/**
+	 * Increments the usage count of the frame unless it is at the maximum.
+	 */
+  void recordAccess(const FrameId frameNo);
+
+	/**
+	 * Sets the usage count of the frame to one.
+	 */
+  void recordLoad(const FrameId frameNo, const File* file, const PageId pageNo);
+
+  void recordUnpin(const FrameId frameNo);
+
+  void recordEviction(const FrameId frameNo, const File* file, const PageId pageNo);
+
+  void recordFree(const FrameId frameNo);
+
+	/**
+	 * Sweeps the clock, decrementing the usage counts of unpinned frames, until it finds an unpinned frame
+	 * whose count is zero. Gives up when a whole sweep found every frame pinned.
+	 */
+  bool pickVictim(FrameId& frameNo, const EvictablePredicate& evictable);
+
+	/**
+	 * Returns the frames among the next count ahead of the hand whose usage count is already zero.
+	 */
+  void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count);
+};
+
+}
@@ -7,31 +7,74 @@
 
 #include "file.h"
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/read_only_file_exception.h"
 #include "file_iterator.h"
+#include "ioEngine.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+const std::size_t File::REGISTRY_SHARDS;
+const std::size_t File::LEGACY_HEADER_SIZE;
+const std::uint32_t File::ALIGNED_LAYOUT;
 
-File File::create(const std::string& filename) {
-  return File(filename, true /* create_new */);
+namespace {
+
+/**
+ * Returns the madvise() flag of an access hint.
+ */
+int adviceFlag(const File::Advice advice) {
+  switch (advice) {
+    case File::Advice::SEQUENTIAL:
+      return MADV_SEQUENTIAL;
+    case File::Advice::RANDOM:
+      return MADV_RANDOM;
+    case File::Advice::WILL_NEED:
+      return MADV_WILLNEED;
+    case File::Advice::DONT_NEED:
+      return MADV_DONTNEED;
+    default:
+      return MADV_NORMAL;
+  }
 }
 
-File File::open(const std::string& filename) {
-  return File(filename, false /* create_new */);
+}
+File::RegistryShard File::registry_[File::REGISTRY_SHARDS];
+std::atomic<std::uint32_t> File::next_id_(1);
+
+File File::create(const std::string& filename, const bool direct) {
+  return File(filename, true /* create_new */, direct);
+}
+
+File File::open(const std::string& filename, const bool direct) {
+  return File(filename, false /* create_new */, direct);
+}
+
+File File::openMapped(const std::string& filename, const Advice advice) {
+  File file(filename, false /* create_new */, false /* direct */,
+            true /* read_only */);
+  file.map(advice);
+  return file;
 }
 
 void File::remove(const std::string& filename) {
@@ -48,32 +91,30 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  RegistryShard& shard = shardFor(filename);
+  std::lock_guard<std::mutex> guard(shard.latch);
+  std::unordered_map<std::string, std::weak_ptr<Handle> >::const_iterator entry =
+      shard.handles.find(filename);
+  return entry != shard.handles.end() && !entry->second.expired();
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+  return ::access(filename.c_str(), F_OK) == 0;
 }
 
 File::File(const File& other)
-  : filename_(other.filename_),
-    stream_(open_streams_[filename_]) {
-  ++open_counts_[filename_];
+  : id_(next_id_++),
+    filename_(other.filename_),
+    handle_(other.handle_),
+    mapping_(other.mapping_) {
 }
 
 File& File::operator=(const File& rhs) {
-  // This accounts for self-assignment and assignment of a File object for the
-  // same file.
-  close();	//close my file and associate me with the new one
+  // Sharing the handle accounts for self-assignment and assignment of a File
+  // object for the same file.
+  handle_ = rhs.handle_;	//close my file and associate me with the new one
   filename_ = rhs.filename_;
-  openIfNeeded(false /* create_new */);
+  mapping_ = rhs.mapping_;
   return *this;
 }
 
@@ -82,45 +123,53 @@ File::~File() {
 }
 
 Page File::allocatePage() {
-  FileHeader header = readHeader();
   Page new_page;
+  allocatePage(&new_page);
+  return new_page;
+}
+
+void File::allocatePage(Page* new_page) {
+  std::lock_guard<std::mutex> guard(handle_->latch);
+  FileHeader header = readHeader();
   Page existing_page;
-  if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-    header.first_free_page = new_page.next_page_number();
+  const bool reused = header.num_free_pages > 0;
+  if (reused) {
+    readPage(header.first_free_page, true /* allow_free */, new_page);
+    new_page->set_page_number(header.first_free_page);
+    header.first_free_page = new_page->next_page_number();
     --header.num_free_pages;
 
     if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
+        header.first_used_page > new_page->page_number()) {
       // Either have no pages used or the head of the used list is a page later
       // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
+      if (header.first_used_page > new_page->page_number()) {
+        new_page->set_next_page_number(header.first_used_page);
       }
-      header.first_used_page = new_page.page_number();
+      header.first_used_page = new_page->page_number();
     } else {
       // New page is reused from somewhere after the beginning, so we need to
       // find where in the used list to insert it.
       PageId next_page_number = Page::INVALID_NUMBER;
       for (FileIterator iter = begin(); iter != end(); ++iter) {
         next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
+        if (next_page_number > new_page->page_number() ||
             next_page_number == Page::INVALID_NUMBER) {
           existing_page = *iter;
           break;
         }
       }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+      existing_page.set_next_page_number(new_page->page_number());
+      new_page->set_next_page_number(next_page_number);
     }
 
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
-    new_page.set_page_number(header.num_pages);
+    new_page->initialize();
+    new_page->set_page_number(header.num_pages);
     if (header.first_used_page == Page::INVALID_NUMBER) {
-      header.first_used_page = new_page.page_number();
+      header.first_used_page = new_page->page_number();
     } else {
       // If we have pages allocated, we need to add the new page to the tail
       // of the linked list.
@@ -131,57 +180,203 @@ Page File::allocatePage() {
         }
       }
       assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
+      existing_page.set_next_page_number(new_page->page_number());
     }
     ++header.num_pages;
   }
-  writePage(new_page.page_number(), new_page);
+  writePage(new_page->page_number(), *new_page);
   if (existing_page.page_number() != Page::INVALID_NUMBER) {
     // If we updated an existing page by inserting the new page into the
     // used list, we need to write it out.
     writePage(existing_page.page_number(), existing_page);
+    recordLink(existing_page);
+  }
+  if (reused) {
+    // Copies of the page from before it was freed may still be written.
+    recordLink(*new_page);
   }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page File::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
-  if (page_number >= header.num_pages) {
+  checkPageNumber(page_number);
+  Page page;
+  readPage(page_number, false /* allow_free */, &page);
+  return page;
+}
+
+void File::readPage(const PageId page_number, Page* page) const {
+  checkPageNumber(page_number);
+  readPage(page_number, false /* allow_free */, page);
+}
+
+void File::readPage(const PageId page_number, const bool allow_free,
+                    Page* page) const {
+  // A Page is laid out exactly as on disk.
+  struct iovec iov = {page, Page::SIZE};
+  transfer(false /* write */, &iov, 1, pagePosition(page_number));
+  if (!allow_free && !page->isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-  return readPage(page_number, false /* allow_free */);
 }
 
-Page File::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
-  if (!allow_free && !page.isUsed()) {
-    throw InvalidPageException(page_number, filename_);
+std::size_t File::readPages(const std::vector<PageId>& page_numbers,
+                            const std::vector<Page*>& pages) const {
+  std::vector<std::size_t> order(page_numbers.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(),
+            [&page_numbers](const std::size_t lhs, const std::size_t rhs) {
+              return page_numbers[lhs] < page_numbers[rhs];
+            });
+
+  // The last page covers the range check of every page.
+  if (!order.empty()) {
+    checkPageNumber(page_numbers[order.back()]);
   }
 
-  return page;
+  std::size_t reads = 0;
+  std::vector<struct iovec> run;
+  std::size_t start = 0;
+  while (start < order.size()) {
+    std::size_t end = start + 1;
+    while (end < order.size() && end - start < MAX_RUN_PAGES &&
+           page_numbers[order[end]] == page_numbers[order[end - 1]] + 1) {
+      ++end;
+    }
+    // A Page is laid out exactly as on disk.
+    run.resize(end - start);
+    for (std::size_t i = start; i < end; ++i) {
+      run[i - start].iov_base = pages[order[i]];
+      run[i - start].iov_len = Page::SIZE;
+    }
+    transfer(false /* write */, &run[0], run.size(),
+             pagePosition(page_numbers[order[start]]));
+    ++reads;
+    start = end;
+  }
+
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    if (!pages[order[i]]->isUsed()) {
+      throw InvalidPageException(page_numbers[order[i]], filename_);
+    }
+  }
+  return reads;
+}
+
+void File::readPageAsync(IoEngine& engine, const PageId page_number,
+                         Page* page,
+                         const std::function<void(std::exception_ptr)>& done)
+    const {
+  struct iovec iov = {page, Page::SIZE};
+  // Direct reads into a page that is not block aligned land in an aligned
+  // bounce buffer first.
+  std::shared_ptr<char> bounce;
+  if (handle_->direct && !isAligned(&iov, 1)) {
+    void* buffer;
+    if (posix_memalign(&buffer, DIRECT_ALIGNMENT, Page::SIZE) != 0) {
+      throw std::bad_alloc();
+    }
+    bounce.reset(static_cast<char*>(buffer), std::free);
+    iov.iov_base = buffer;
+  }
+  const std::string name = filename_;
+  engine.prepare(handle_->fd, &iov, 1, pagePosition(page_number),
+                 false /* write */, [name, page_number, page, bounce, done](
+                     const ssize_t result) {
+    if (result < 0) {
+      done(std::make_exception_ptr(FileIOException(name, -result)));
+      return;
+    }
+    if (bounce && static_cast<std::size_t>(result) >= Page::SIZE) {
+      std::memcpy(page, bounce.get(), Page::SIZE);
+    }
+    // Past the end of the file.
+    if (static_cast<std::size_t>(result) < Page::SIZE) {
+      std::memset(static_cast<void*>(page), 0, Page::SIZE);
+    }
+    if (!page->isUsed()) {
+      done(std::make_exception_ptr(InvalidPageException(page_number, name)));
+      return;
+    }
+    done(std::exception_ptr());
+  });
 }
 
 void File::writePage(const Page& new_page) {
-  PageHeader header = readPageHeader(new_page.page_number());
-  if (header.current_page_number == Page::INVALID_NUMBER) {
-    // Page has been deleted since it was read.
-    throw InvalidPageException(new_page.page_number(), filename_);
+  std::lock_guard<std::mutex> guard(handle_->latch);
+  const PageId next_page_number = linkToWrite(new_page);
+  if (next_page_number == new_page.next_page_number()) {
+    writePage(new_page.page_number(), new_page);
+    return;
   }
-  // Page on disk may have had its next page pointer updated since it was read;
+  // Page on disk has had its next page pointer updated since it was read;
   // we don't modify that, but we do keep all the other modifications to the
-  // page header.
-  const PageId next_page_number = header.next_page_number;
-  header = new_page.header_;
-  header.next_page_number = next_page_number;
-  writePage(new_page.page_number(), header, new_page);
+  // page.
+  Page relinked = new_page;
+  relinked.set_next_page_number(next_page_number);
+  writePage(new_page.page_number(), relinked);
+}
+
+std::size_t File::writePages(const std::vector<const Page*>& pages) {
+  std::vector<const Page*> sorted(pages);
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Page* lhs, const Page* rhs) {
+              return lhs->page_number() < rhs->page_number();
+            });
+
+  // Check every page before writing any, keeping the next page pointers on
+  // disk as writePage() does.  The few pages relinked since they were read
+  // are written from copies.
+  std::lock_guard<std::mutex> guard(handle_->latch);
+  std::vector<std::size_t> stale;
+  std::vector<PageId> links;
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    const PageId next_page_number = linkToWrite(*sorted[i]);
+    if (next_page_number != sorted[i]->next_page_number()) {
+      stale.push_back(i);
+      links.push_back(next_page_number);
+    }
+  }
+  std::vector<Page> relinked(stale.size());
+  for (std::size_t i = 0; i < stale.size(); ++i) {
+    relinked[i] = *sorted[stale[i]];
+    relinked[i].set_next_page_number(links[i]);
+    sorted[stale[i]] = &relinked[i];
+  }
+
+  std::size_t writes = 0;
+  std::vector<struct iovec> run;
+  std::size_t start = 0;
+  while (start < sorted.size()) {
+    std::size_t end = start + 1;
+    while (end < sorted.size() && end - start < MAX_RUN_PAGES &&
+           sorted[end]->page_number() == sorted[end - 1]->page_number() + 1) {
+      ++end;
+    }
+    // A Page is laid out exactly as on disk.
+    run.resize(end - start);
+    for (std::size_t i = start; i < end; ++i) {
+      run[i - start].iov_base = const_cast<Page*>(sorted[i]);
+      run[i - start].iov_len = Page::SIZE;
+    }
+    transfer(true /* write */, &run[0], run.size(),
+             pagePosition(sorted[start]->page_number()));
+    ++writes;
+    start = end;
+  }
+  return writes;
+}
+
+void File::sync() const {
+  if (::fdatasync(handle_->fd) != 0) {
+    throw FileIOException(filename_, errno);
+  }
 }
 
 void File::deletePage(const PageId page_number) {
+  std::lock_guard<std::mutex> guard(handle_->latch);
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
   Page previous_page;
@@ -206,8 +401,11 @@ void File::deletePage(const PageId page_number) {
   ++header.num_free_pages;
   if (previous_page.isUsed()) {
     writePage(previous_page.page_number(), previous_page);
+    recordLink(previous_page);
   }
   writePage(page_number, existing_page);
+  handle_->next_pages.erase(page_number);
+  handle_->free_pages.insert(page_number);
   writeHeader(header);
 }
 
@@ -220,84 +418,329 @@ FileIterator File::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+File::File(const std::string& name, const bool create_new, const bool direct,
+           const bool read_only)
+  : id_(next_id_++),
+    filename_(name) {
+  openIfNeeded(create_new, direct, read_only);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         handle_->aligned ? ALIGNED_LAYOUT : 0 /* layout */};
     writeHeader(header);
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+void File::openIfNeeded(const bool create_new, const bool direct,
+                        const bool read_only) {
+  RegistryShard& shard = shardFor(filename_);
+  std::lock_guard<std::mutex> guard(shard.latch);
+  handle_ = shard.handles[filename_].lock();
+  if (handle_ && (read_only || !handle_->read_only)) {
+    //exists an open descriptor already
+    return;
+  }
+  // A read-only descriptor cannot serve writers; open a writable one and let
+  // later opens share that instead.
+  int flags = read_only ? O_RDONLY : O_RDWR;
+  if (create_new) {
+    // Error if we try to overwrite an existing file.
+    flags |= O_CREAT | O_EXCL;
+  }
+  // O_DIRECT is only turned on once the layout is known.
+  const int fd = ::open(filename_.c_str(), flags, 0666);
+  if (fd < 0) {
+    if (errno == EEXIST) {
+      throw FileExistsException(filename_);
+    }
+    // Error if we try to open a file that doesn't exist.
+    if (errno == ENOENT) {
+      throw FileNotFoundException(filename_);
+    }
+    throw FileIOException(filename_, errno);
+  }
+
+  // A new file has its header written by the constructor.
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  if (create_new) {
+    header.layout = direct ? ALIGNED_LAYOUT : 0;
+    // The file header gets a page of its own.
+    if (direct && ::ftruncate(fd, Page::SIZE) != 0) {
+      const int error = errno;
+      ::close(fd);
+      throw FileIOException(filename_, error);
+    }
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
-    if (create_new) {
-      // Error if we try to overwrite an existing file.
-      if (already_exists) {
-        throw FileExistsException(filename_);
-      }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
-    } else {
-      // Error if we try to open a file that doesn't exist.
-      if (!already_exists) {
-        throw FileNotFoundException(filename_);
-      }
+    ssize_t done;
+    do {
+      done = ::pread(fd, &header, sizeof(header), 0);
+    } while (done < 0 && errno == EINTR);
+    if (done < 0) {
+      const int error = errno;
+      ::close(fd);
+      throw FileIOException(filename_, error);
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
   }
+  const bool aligned = header.layout == ALIGNED_LAYOUT;
+  // Pages of the old layout are not aligned for direct I/O, and the
+  // filesystem may not support it at all.
+  const bool direct_io = direct && aligned &&
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_DIRECT) == 0;
+  handle_.reset(new Handle(filename_, fd, direct_io, aligned, read_only,
+                           header.num_pages));
+  shard.handles[filename_] = handle_;
+}
+
+void File::map(const Advice advice) {
+  struct stat status;
+  if (::fstat(handle_->fd, &status) != 0) {
+    throw FileIOException(filename_, errno);
+  }
+  if (status.st_size == 0) {
+    return;
+  }
+  void* start = ::mmap(NULL, status.st_size, PROT_READ, MAP_SHARED,
+                       handle_->fd, 0);
+  if (start == MAP_FAILED) {
+    throw FileIOException(filename_, errno);
+  }
+  mapping_.reset(new Mapping(static_cast<const char*>(start), status.st_size));
+  ::madvise(start, status.st_size, adviceFlag(advice));
+}
+
+const Page* File::mappedPage(const PageId page_number) const {
+  if (!mapping_) {
+    return nullptr;
+  }
+  if (page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const std::size_t position = pagePosition(page_number);
+  if (position + Page::SIZE > mapping_->length) {
+    return nullptr;
+  }
+  // A Page is laid out exactly as on disk.
+  const Page* page =
+      reinterpret_cast<const Page*>(mapping_->address + position);
+  if (!page->isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return page;
+}
+
+void File::advise(const Advice advice, const PageId first_page,
+                  const PageId page_count) const {
+  if (!mapping_ || page_count == 0) {
+    return;
+  }
+  // madvise() wants a start on a memory page boundary.
+  static const std::size_t memory_page = ::sysconf(_SC_PAGESIZE);
+  std::size_t begin = pagePosition(first_page);
+  std::size_t end = begin + static_cast<std::size_t>(page_count) * Page::SIZE;
+  begin -= begin % memory_page;
+  if (begin >= mapping_->length) {
+    return;
+  }
+  end = std::min(end, mapping_->length);
+  ::madvise(const_cast<char*>(mapping_->address) + begin, end - begin,
+            adviceFlag(advice));
 }
 
 void File::close() {
-  --open_counts_[filename_];
-  stream_.reset();
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+  mapping_.reset();
+  handle_.reset();
+}
+
+File::RegistryShard& File::shardFor(const std::string& filename) {
+  return registry_[std::hash<std::string>()(filename) % REGISTRY_SHARDS];
+}
+
+File::Handle::Handle(const std::string& name, const int descriptor,
+                     const bool direct_io, const bool aligned_layout,
+                     const bool read_only_access, const PageId page_count)
+  : filename(name),
+    fd(descriptor),
+    direct(direct_io),
+    aligned(aligned_layout),
+    read_only(read_only_access),
+    num_pages(page_count) {
+}
+
+File::Mapping::Mapping(const char* start, const std::size_t size)
+  : address(start),
+    length(size) {
+}
+
+File::Mapping::~Mapping() {
+  ::munmap(const_cast<char*>(address), length);
+}
+
+File::Handle::~Handle() {
+  ::close(fd);
+  RegistryShard& shard = shardFor(filename);
+  std::lock_guard<std::mutex> guard(shard.latch);
+  // The file may have been opened again since the last reference went away.
+  std::unordered_map<std::string, std::weak_ptr<Handle> >::iterator entry =
+      shard.handles.find(filename);
+  if (entry != shard.handles.end() && entry->second.expired()) {
+    shard.handles.erase(entry);
+  }
+}
+
+void File::transfer(const bool write, struct iovec* iov, int count,
+                    off_t offset) const {
+  if (mapping_) {
+    if (write) {
+      throw ReadOnlyFileException(filename_);
+    }
+    std::size_t length = 0;
+    for (int i = 0; i < count; ++i) {
+      length += iov[i].iov_len;
+    }
+    if (static_cast<std::size_t>(offset) + length <= mapping_->length) {
+      const char* source = mapping_->address + offset;
+      for (int i = 0; i < count; ++i) {
+        std::memcpy(iov[i].iov_base, source, iov[i].iov_len);
+        source += iov[i].iov_len;
+      }
+      return;
+    }
+  }
+  if (!handle_->direct ||
+      (offset % DIRECT_ALIGNMENT == 0 && isAligned(iov, count))) {
+    transferVector(write, iov, count, offset);
+    return;
+  }
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  const std::size_t padded =
+      (length + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+  void* buffer;
+  if (posix_memalign(&buffer, DIRECT_ALIGNMENT, padded) != 0) {
+    throw std::bad_alloc();
+  }
+  std::unique_ptr<char, void (*)(void*)> bounce(static_cast<char*>(buffer),
+                                                std::free);
+  std::size_t position = 0;
+  if (write) {
+    for (int i = 0; i < count; ++i) {
+      std::memcpy(bounce.get() + position, iov[i].iov_base, iov[i].iov_len);
+      position += iov[i].iov_len;
+    }
+    std::memset(bounce.get() + length, 0, padded - length);
+  }
+  struct iovec aligned_iov = {bounce.get(), padded};
+  transferVector(write, &aligned_iov, 1, offset);
+  if (!write) {
+    for (int i = 0; i < count; ++i) {
+      std::memcpy(iov[i].iov_base, bounce.get() + position, iov[i].iov_len);
+      position += iov[i].iov_len;
+    }
+  }
+}
+
+bool File::isAligned(const struct iovec* iov, const int count) {
+  for (int i = 0; i < count; ++i) {
+    if (reinterpret_cast<std::uintptr_t>(iov[i].iov_base) % DIRECT_ALIGNMENT !=
+            0 ||
+        iov[i].iov_len % DIRECT_ALIGNMENT != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void File::transferVector(const bool write, struct iovec* iov, int count,
+                          off_t offset) const {
+  while (count > 0) {
+    const ssize_t done = write ? ::pwritev(handle_->fd, iov, count, offset)
+                               : ::preadv(handle_->fd, iov, count, offset);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, errno);
+    }
+    if (done == 0 && !write) {
+      // Past the end of the file.
+      for (int i = 0; i < count; ++i) {
+        std::memset(iov[i].iov_base, 0, iov[i].iov_len);
+      }
+      return;
+    }
+    offset += done;
+    std::size_t left = done;
+    while (count > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
   }
 }
 
 void File::writePage(const PageId page_number, const Page& new_page) {
-  writePage(page_number, new_page.header_, new_page);
+  // A Page is laid out exactly as on disk.
+  struct iovec iov = {const_cast<Page*>(&new_page), Page::SIZE};
+  transfer(true /* write */, &iov, 1, pagePosition(page_number));
+}
+
+void File::checkPageNumber(const PageId page_number) const {
+  if (page_number < handle_->num_pages.load() ||
+      page_number < readHeader().num_pages) {
+    return;
+  }
+  throw InvalidPageException(page_number, filename_);
 }
 
-void File::writePage(const PageId page_number, const PageHeader& header,
-                     const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+void File::recordLink(const Page& page) {
+  handle_->free_pages.erase(page.page_number());
+  handle_->next_pages[page.page_number()] = page.next_page_number();
+}
+
+PageId File::linkToWrite(const Page& page) const {
+  if (handle_->free_pages.count(page.page_number()) != 0) {
+    // Page has been deleted since it was read.
+    throw InvalidPageException(page.page_number(), filename_);
+  }
+  std::unordered_map<PageId, PageId>::const_iterator link =
+      handle_->next_pages.find(page.page_number());
+  return link == handle_->next_pages.end() ? page.next_page_number()
+                                           : link->second;
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  const std::size_t size =
+      handle_->aligned ? sizeof(header) : LEGACY_HEADER_SIZE;
+  header.layout = 0;
+  struct iovec iov = {&header, size};
+  transfer(false /* write */, &iov, 1, 0 /* pos */);
 
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->flush();
+  FileHeader disk_header = header;
+  const std::size_t size =
+      handle_->aligned ? sizeof(disk_header) : LEGACY_HEADER_SIZE;
+  struct iovec iov = {&disk_header, size};
+  transfer(true /* write */, &iov, 1, 0 /* pos */);
+  handle_->num_pages.store(header.num_pages);
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  struct iovec iov = {&header, sizeof(header)};
+  transfer(false /* write */, &iov, 1, pagePosition(page_number));
 
   return header;
 }
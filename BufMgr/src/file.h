@@ -7,16 +7,25 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <string>
-#include <map>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #include "page.h"
 
 namespace badgerdb {
 
 class FileIterator;
+class IoEngine;
 
 /**
  * @brief Header metadata for files on disk which contain pages.
@@ -42,6 +51,13 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * File::ALIGNED_LAYOUT if every page of the file starts at a multiple of
+   * Page::SIZE.  Files in the layout of earlier versions have no such field;
+   * their header ends right before it.
+   */
+  std::uint32_t layout;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +68,8 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        layout == rhs.layout;
   }
 };
 
@@ -60,37 +77,76 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a descriptor of an underlying file on disk.  Files
+ * contain fixed-sized pages, and they never deallocate space (though they do
+ * reuse deleted pages if possible).  If multiple File objects refer to the same
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the registry_ of open files) and just returns a file object with
+ * the already open descriptor for the file without actually opening the UNIX file again.
  *
- * @warning This class is not threadsafe.
+ * All I/O is positional (pread/pwrite), so there is no shared file position
+ * and no stream buffering.  Reads may run concurrently with each other and with
+ * any other call.  The number of pages is kept with the descriptor, so reads
+ * do not go back to the file header to check page numbers.
+ *
+ * Calls that write (allocatePage, writePage, writePages, deletePage)
+ * read-modify-write page and file headers, so they wait for each other on a
+ * latch of the descriptor.  Writes to different files do not.
  */
 class File {
  public:
   /**
    * Creates a new file.
    *
+   * Only files created for direct I/O are laid out with every page aligned
+   * to Page::SIZE; buffered files keep the compact layout of earlier
+   * versions.
+   *
    * @param filename  Name of the file.
+   * @param direct    Whether to bypass the kernel page cache (O_DIRECT).
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static File create(const std::string& filename);
+  static File create(const std::string& filename, const bool direct = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created shares the descriptor of
+	 * that already open file. Otherwise the UNIX file is actually opened and its descriptor is entered in the registry_
+	 * of open files. The descriptor is closed when the last File object sharing it goes away.
+	 * A File object sharing the descriptor of an open file also shares whether it bypasses the page cache.
    *
    * @param filename  Name of the file.
+   * @param direct    Whether to bypass the kernel page cache (O_DIRECT).
+   *                  Files not created for direct I/O, and files on
+   *                  filesystems without direct I/O, are opened buffered.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static File open(const std::string& filename);
+  static File open(const std::string& filename, const bool direct = false);
+
+  /**
+   * Access hints for a memory-mapped file, passed on to madvise().
+   */
+  enum class Advice { NORMAL, SEQUENTIAL, RANDOM, WILL_NEED, DONT_NEED };
+
+  /**
+   * Opens an existing file read-only and maps all of it into memory, so it
+   * works on files the caller may not write.  readPage() and the buffer
+   * manager still copy each page out of the mapping into the caller's
+   * buffer or frame, saving only the system call; every buffer manager
+   * reading the file keeps its own copy.  mappedPage() reads a page in place,
+   * without any copy.
+   * Writes through the returned File object, or its copies, throw
+   * ReadOnlyFileException.  Pages added to the file after it was mapped are
+   * read with pread() instead.
+   *
+   * @param filename  Name of the file.
+   * @param advice    How the file is going to be read.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileIOException         If the file cannot be mapped.
+   */
+  static File openMapped(const std::string& filename,
+                         const Advice advice = Advice::NORMAL);
 
   /**
    * Deletes an existing file.
@@ -145,6 +201,14 @@ class File {
    */
   Page allocatePage();
 
+  /**
+   * Allocates a new page in the file into the given page, reusing its memory
+   * instead of returning a copy.
+   *
+   * @param new_page  Page to overwrite with the new page.
+   */
+  void allocatePage(Page* new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -155,15 +219,91 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page,
+   * e.g. a frame of the buffer pool, without a temporary copy.  The page is
+   * left with undefined contents if the read fails.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to overwrite with the page read.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page* page) const;
+
+  /**
+   * Reads several existing pages from the file straight into the given
+   * pages, like readPage() does for each of them.  The pages are read in page
+   * number order and runs of adjacent pages are read with one preadv() call
+   * each, at most MAX_RUN_PAGES pages long.  The pages are left with
+   * undefined contents if the read fails.
+   *
+   * @param page_numbers  Numbers of the pages to read, in any order, each at
+   *                      most once.
+   * @param pages         Pages to read into, one per page number.
+   * @return  Number of read calls issued.
+   * @throws  InvalidPageException  If a page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  std::size_t readPages(const std::vector<PageId>& page_numbers,
+                        const std::vector<Page*>& pages) const;
+
+  /**
+   * Queues a read of an existing page on an I/O engine.  Unlike readPage(),
+   * the page number is not checked against the file header; pages past the
+   * end of the file read as unused and fail with InvalidPageException.
+   *
+   * @param engine        Engine to queue the read on.  The caller submits it.
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into, valid until done is called.
+   * @param done          Called once the read completes, with a null pointer
+   *                      or the InvalidPageException or FileIOException the
+   *                      read failed with.
+   */
+  void readPageAsync(IoEngine& engine, const PageId page_number, Page* page,
+                     const std::function<void(std::exception_ptr)>& done) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
+   * If allocatePage() or deletePage() has since relinked the page, the next
+   * page pointer they wrote is kept instead of the one in new_page.
    *
    * @see allocatePage()
    * @param new_page  Page to write.
+   * @throws  InvalidPageException  If the page has been deleted from the file.
    */
   void writePage(const Page& new_page);
 
+  /**
+   * Writes several pages into the file, like writePage() does for each of
+   * them.  The pages are sorted by page number and runs of adjacent pages are
+   * written with one pwritev() call each, at most MAX_RUN_PAGES pages long.
+   * Nothing is written if any page has been deleted.  Each page is written
+   * straight from its memory, so runs of pages aligned to DIRECT_ALIGNMENT
+   * need no copy on a direct file.  Like writePage(), it leaves the pages in
+   * the page cache; call sync() to make them durable.
+   *
+   * @param pages   Pages to write, in any order, each at most once.
+   * @return  Number of write calls issued.
+   * @throws  InvalidPageException  If a page has been deleted from the file.
+   */
+  std::size_t writePages(const std::vector<const Page*>& pages);
+
+  /**
+   * Waits until all data written to the file so far is on stable storage,
+   * with fdatasync().
+   *
+   * @throws  FileIOException  If the data could not be synced.
+   */
+  void sync() const;
+
+  /**
+   * Longest run of adjacent pages readPages() and writePages() transfer in
+   * one call.
+   */
+  static const std::size_t MAX_RUN_PAGES = 64;
+
   /**
    * Deletes a page from the file.
    *
@@ -178,6 +318,63 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns a number identifying this File object, unique among all File
+   * objects created by the process (modulo wraparound).  Like the object's
+   * address, it does not change when another file is assigned to it.
+   *
+   * @return Identifier of this object.
+   */
+  std::uint32_t id() const { return id_; }
+
+  /**
+   * Returns true if I/O on this file bypasses the kernel page cache.
+   */
+  bool isDirect() const { return handle_->direct; }
+
+  /**
+   * Alignment of file offsets, lengths and memory of direct I/O.
+   */
+  static const std::size_t DIRECT_ALIGNMENT = 4096;
+
+  /**
+   * Returns true if this File object reads from a memory mapping.
+   */
+  bool isMapped() const { return mapping_ != nullptr; }
+
+  /**
+   * Value of FileHeader::layout in files of the aligned layout.  Its upper
+   * half is larger than any free space bound, so it never matches the start
+   * of page 1 in the layout of earlier versions.
+   */
+  static const std::uint32_t ALIGNED_LAYOUT = 0x414C4E47;
+
+  /**
+   * Returns the page with the given number right where it lies in the
+   * mapping, without copying it.  The page stays valid, and reflects later
+   * writes to the file, as long as this File object or a copy of it exists.
+   *
+   * @param page_number   Number of page to look up.
+   * @return  The page, or null if the file is not mapped or the page was
+   *          added to the file after it was mapped.  Read those with
+   *          readPage().
+   * @throws  InvalidPageException  If the page is in the mapping but not
+   *                                currently used.
+   */
+  const Page* mappedPage(const PageId page_number) const;
+
+  /**
+   * Passes an access hint for a range of pages to madvise(), e.g.
+   * Advice::WILL_NEED to have them read in ahead of use.  Does nothing
+   * unless the file is mapped.
+   *
+   * @param advice        How the pages are going to be read.
+   * @param first_page    Number of the first page of the range.
+   * @param page_count    Number of pages in the range.
+   */
+  void advise(const Advice advice, const PageId first_page,
+              const PageId page_count) const;
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -201,10 +398,50 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    // The file header takes up a whole page in the aligned layout.
+    if (handle_->aligned) {
+      return static_cast<off_t>(page_number) * Page::SIZE;
+    }
+    return LEGACY_HEADER_SIZE + ((page_number - 1) * Page::SIZE);
   }
 
+  /**
+   * Size of the file header in the layout of earlier versions, which stops
+   * before FileHeader::layout.
+   */
+  static const std::size_t LEGACY_HEADER_SIZE = offsetof(FileHeader, layout);
+
+  /**
+   * Throws InvalidPageException unless the page number is below the number of
+   * pages in the file.  Only goes back to the file header if the number kept
+   * with the descriptor is too small, e.g. because the file was extended
+   * through another descriptor.
+   *
+   * @param page_number   Number of page to check.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
+   */
+  void checkPageNumber(const PageId page_number) const;
+
+  /**
+   * Records the next page pointer allocatePage() or deletePage() wrote into a
+   * used page, for writePage() and writePages() to keep.  Must be called with
+   * the latch of <handle_> held.
+   *
+   * @param page  Page as written.
+   */
+  void recordLink(const Page& page);
+
+  /**
+   * Returns the next page pointer to write with a page: the one last recorded
+   * by recordLink(), or the page's own.  Must be called with the latch of
+   * <handle_> held.
+   *
+   * @param page  Page to be written.
+   * @throws  InvalidPageException  If the page has been deleted from the file.
+   */
+  PageId linkToWrite(const Page& page) const;
+
   /**
    * Constructs a file object representing a file on the filesystem.
    * This method should not be called directly; instead use the static methods
@@ -214,28 +451,48 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct      Whether to bypass the kernel page cache.
+   * @param read_only   Whether to open the file for reading only.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new, const bool direct,
+       const bool read_only = false);
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
+   * New direct files are created in the aligned layout, where every page
+   * starts at a multiple of Page::SIZE, and other new files in the layout of
+   * earlier versions, with pages right after the file header.  The layout of
+   * an existing file is read from FileHeader::layout.
+   * A read-only descriptor is only reused by other read-only opens.
    *
    * @param create_new  Whether to create a new file.
+   * @param direct      Whether to bypass the kernel page cache.
+   * @param read_only   Whether to open the file with O_RDONLY.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool direct,
+                    const bool read_only);
+
+  /**
+   * Maps the whole file read-only into <mapping_>.  Empty files are not
+   * mapped.
+   *
+   * @param advice  Hint for the whole mapping.
+   * @throws  FileIOException  If the operating system fails the call.
+   */
+  void map(const Advice advice);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Releases the descriptor in <handle_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
@@ -245,48 +502,40 @@ class File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeroes, i.e. as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
+   * @param page          Page to overwrite with the page read.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
-
-  /**
-   * Writes a page into the file at the given page number.  This does not
-   * update ensure that the number in the header equals the position on disk.
-   * No bounds checking is performed.
-   *
-   * @param page_number Number of page whose contents to replace.
-   * @param new_page    Page to write.
-   */
-  void writePage(const PageId page_number, const Page& new_page);
+  void readPage(const PageId page_number, const bool allow_free,
+                Page* page) const;
 
   /**
-   * Writes a page into the file at the given page number with the given header.
-   * This does not ensure that the number in the header equals the position on
+   * Writes a page into the file at the given page number, in one piece.  This
+   * does not ensure that the number in the header equals the position on
    * disk.  No bounds checking is performed.
    *
    * @param page_number Number of page whose contents to replace.
-   * @param header      Header of page to write.
    * @param new_page    Page to write.
    */
-  void writePage(const PageId page_number, const PageHeader& header,
-                 const Page& new_page);
+  void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Reads the header for this file from disk.
+   * Reads the header for this file from disk.  In the layout of earlier
+   * versions, FileHeader::layout reads as zero.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Writes the given header to the disk as the header for this file, and
+   * keeps its number of pages with the descriptor.  FileHeader::layout is
+   * not written in the layout of earlier versions.
    *
    * @param header  File header to write.
    */
@@ -301,19 +550,176 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
-  typedef std::map<std::string,
-                   std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Reads into or writes from the given buffers at the given offset, retrying
+   * after short transfers and interrupts.  Reads past the end of the file fill
+   * the rest of the buffers with zeroes.  Modifies iov.
+   *
+   * Reads of a mapped file copy out of the mapping, and writes throw
+   * ReadOnlyFileException.
+   *
+   * On a direct file the transfer goes through an aligned bounce buffer,
+   * rounded up to whole DIRECT_ALIGNMENT blocks, unless the offset and all
+   * buffers are block aligned already.  The rounding only ever
+   * covers the padding after the file header, which writes fill with zeroes.
+   *
+   * @param write   True to write, false to read.
+   * @param iov     Buffers.
+   * @param count   Number of buffers.
+   * @param offset  Position in the file of the first byte.
+   * @throws  FileIOException  If the operating system fails the call.
+   * @throws  ReadOnlyFileException  If a mapped file is written.
+   */
+  void transfer(const bool write, struct iovec* iov, int count,
+                off_t offset) const;
+
+  /**
+   * Returns true if all buffers start and end on DIRECT_ALIGNMENT boundaries.
+   */
+  static bool isAligned(const struct iovec* iov, const int count);
+
+  /**
+   * Does what transfer() does, without a bounce buffer.
+   */
+  void transferVector(const bool write, struct iovec* iov, int count,
+                      off_t offset) const;
+
+  /**
+   * Open descriptor of a file, shared by all File objects for it.
+   */
+  struct Handle {
+    /**
+     * Takes over an open descriptor.
+     */
+    Handle(const std::string& name, const int descriptor,
+           const bool direct_io, const bool aligned_layout,
+           const bool read_only_access, const PageId page_count);
+
+    /**
+     * Closes the descriptor and takes it out of the registry.
+     */
+    ~Handle();
+
+    /**
+     * Name the file was opened with.
+     */
+    std::string filename;
+
+    /**
+     * Open descriptor.
+     */
+    int fd;
+
+    /**
+     * Whether the descriptor was opened with O_DIRECT.
+     */
+    bool direct;
+
+    /**
+     * Whether the file is in the aligned layout.
+     */
+    bool aligned;
+
+    /**
+     * Whether the descriptor was opened with O_RDONLY.
+     */
+    bool read_only;
+
+    /**
+     * Number of pages in the file, as of the last header read or written
+     * through this descriptor.
+     */
+    std::atomic<PageId> num_pages;
+
+    /**
+     * Serializes the calls that write the file, and protects next_pages and
+     * free_pages.
+     */
+    std::mutex latch;
+
+    /**
+     * Next page pointers allocatePage() and deletePage() wrote into used
+     * pages since the file was opened, by page number.  Copies of these pages
+     * read before may be stale.
+     */
+    std::unordered_map<PageId, PageId> next_pages;
+
+    /**
+     * Pages deletePage() freed since the file was opened and allocatePage()
+     * has not reused.
+     */
+    std::unordered_set<PageId> free_pages;
+  };
 
   /**
-   * Streams for opened files.
+   * Read-only mapping of a file, unmapped when the last File object using
+   * it goes away.
    */
-  static StreamMap open_streams_;
+  struct Mapping {
+    /**
+     * Takes over a mapping.
+     */
+    Mapping(const char* start, const std::size_t size);
+
+    /**
+     * Unmaps the file.
+     */
+    ~Mapping();
+
+    /**
+     * First byte of the file.
+     */
+    const char* address;
+
+    /**
+     * Number of bytes mapped.
+     */
+    std::size_t length;
+  };
+
+  /**
+   * Part of the registry of open files.  Entries expire when the last File
+   * object of the file goes away.
+   */
+  struct RegistryShard {
+    /**
+     * Protects handles.
+     */
+    std::mutex latch;
+
+    /**
+     * Handles of open files, by file name.
+     */
+    std::unordered_map<std::string, std::weak_ptr<Handle> > handles;
+  };
+
+  /**
+   * Number of parts of the registry, so opens of different files seldom
+   * wait for each other.
+   */
+  static const std::size_t REGISTRY_SHARDS = 16;
+
+  /**
+   * Returns the part of the registry a file belongs to.
+   *
+   * @param filename  Name of file.
+   */
+  static RegistryShard& shardFor(const std::string& filename);
+
+  /**
+   * Registry of open files.
+   */
+  static RegistryShard registry_[REGISTRY_SHARDS];
+
+  /**
+   * Identifier handed to the next File object constructed.
+   */
+  static std::atomic<std::uint32_t> next_id_;
 
   /**
-   * Counts for opened files.
+   * Identifier of this object.
    */
-  static CountMap open_counts_;
+  std::uint32_t id_;
 
   /**
    * Name of the file this object represents.
@@ -321,9 +727,14 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of underlying filesystem object.
+   */
+  std::shared_ptr<Handle> handle_;
+
+  /**
+   * Mapping reads are served from, null unless opened by openMapped().
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<const Mapping> mapping_;
 
   friend class FileIterator;
   friend class FileTest;
@@ -0,0 +1,117 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+* @brief Layout of the state word kept for every frame.
+*
+* The pin count and the flags of a frame are packed into one 64-bit word. The words of all frames lie in one
+* dense array, so a sweep reads 8 bytes per frame, and a word is only ever changed by single atomic
+* operations, compare-and-swap where the new value depends on the old one. Bits 32 to 39 hold a usage count
+* owned by the replacement policy, so a clock sweep learns whether a frame is pinned and how hot it is from
+* the same load.
+*/
+struct FrameState
+{
+	/**
+   * Pin count, bits 0 to 31
+	 */
+  static const std::uint64_t PIN_MASK = 0xFFFFFFFFull;
+
+	/**
+   * One pin
+	 */
+  static const std::uint64_t PIN_ONE = 1ull;
+
+	/**
+   * Position of the usage count, bits 32 to 39
+	 */
+  static const std::uint32_t USAGE_SHIFT = 32;
+
+	/**
+   * Usage count, only changed by the replacement policy. Cleared with the page in the frame.
+	 */
+  static const std::uint64_t USAGE_MASK = 0xFFull << USAGE_SHIFT;
+
+	/**
+   * A usage count of one
+	 */
+  static const std::uint64_t USAGE_ONE = 1ull << USAGE_SHIFT;
+
+	/**
+   * Largest usage count
+	 */
+  static const std::uint32_t MAX_USAGE = 255;
+
+	/**
+   * The frame holds a page. Only changed under the frame latch, together with the identity of the frame.
+	 */
+  static const std::uint64_t VALID = 1ull << 40;
+
+	/**
+   * The page was changed since it was read or last written back
+	 */
+  static const std::uint64_t DIRTY = 1ull << 41;
+
+	/**
+   * An asynchronous read of the page into the frame is in flight. The page is in the page table and pinned
+   * by the reader meanwhile, but must not be used. Cleared under the load latch of the buffer manager.
+	 */
+  static const std::uint64_t LOADING = 1ull << 42;
+
+	/**
+   * The page was read in through an access strategy and has not been accessed without one since, so its
+   * frame may be recycled by the strategy's ring
+	 */
+  static const std::uint64_t IN_RING = 1ull << 43;
+
+	/**
+   * The frame has an entry in the free-frame list. Only changed under the latch of the list.
+	 */
+  static const std::uint64_t IN_FREE_LIST = 1ull << 44;
+
+	/**
+   * The page was read ahead and nobody has pinned it without an access strategy since. The replacement
+   * policy only learns of the page once somebody does, so until then it is among the first to go.
+	 */
+  static const std::uint64_t PREFETCHED = 1ull << 45;
+
+	/**
+   * The page is being written back from a copy without the frame being pinned. The frame keeps the page
+   * until the write is done, so nobody reads an older version of it back from disk meanwhile. Cleared under
+   * the load latch of the buffer manager.
+	 */
+  static const std::uint64_t WRITING = 1ull << 46;
+
+	/**
+   * Flags that outlive the page in the frame
+	 */
+  static const std::uint64_t FRAME_FLAGS = LOADING | IN_FREE_LIST;
+
+	/**
+	 * Returns the pin count of a state word.
+	 */
+  static std::uint32_t pinCount(const std::uint64_t state)
+	{
+		return (std::uint32_t)(state & PIN_MASK);
+	}
+
+	/**
+	 * Returns the usage count of a state word.
+	 */
+  static std::uint32_t usage(const std::uint64_t state)
+	{
+		return (std::uint32_t)((state & USAGE_MASK) >> USAGE_SHIFT);
+	}
+};
+
+}
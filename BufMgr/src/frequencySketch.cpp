@@ -0,0 +1,88 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "frequencySketch.h"
+
+namespace badgerdb {
+
+const std::uint32_t FrequencySketch::DEPTH;
+const std::uint8_t FrequencySketch::MAX_COUNT;
+
+FrequencySketch::FrequencySketch(const std::uint32_t frames)
+	: sampleSize(10 * (frames > 0 ? frames : 1)), additions(0)
+{
+	//Eight counters per frame and row, so the long tail of pages that never
+	//fit in the pool does not pile up on the counters of the hot ones
+	width = 16;
+	while(width < 8 * (std::uint64_t)frames)
+	{
+		width <<= 1;
+	}
+	counters = new std::atomic<std::uint8_t>[DEPTH * width];
+	for (std::uint32_t i = 0; i < DEPTH * width; i++)
+	{
+		counters[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+FrequencySketch::~FrequencySketch()
+{
+	delete [] counters;
+}
+
+std::uint32_t FrequencySketch::index(const std::uint64_t hash, const std::uint32_t row) const
+{
+	//Double hashing, one independent-enough position per row from two halves
+	std::uint32_t h1 = (std::uint32_t)hash;
+	std::uint32_t h2 = (std::uint32_t)(hash >> 32) | 1;
+	return row * width + ((h1 + row * h2) & (width - 1));
+}
+
+void FrequencySketch::increment(const std::uint64_t hash)
+{
+	bool added = false;
+	for (std::uint32_t row = 0; row < DEPTH; row++)
+	{
+		std::atomic<std::uint8_t>& counter = counters[index(hash, row)];
+		std::uint8_t count = counter.load(std::memory_order_relaxed);
+		if(count < MAX_COUNT)
+		{
+			counter.store(count + 1, std::memory_order_relaxed);
+			added = true;
+		}
+	}
+	//Only the thread completing the sample ages the counters
+	if(added && additions.fetch_add(1, std::memory_order_relaxed) + 1 == sampleSize)
+	{
+		age();
+	}
+}
+
+std::uint32_t FrequencySketch::estimate(const std::uint64_t hash) const
+{
+	std::uint32_t count = MAX_COUNT;
+	for (std::uint32_t row = 0; row < DEPTH; row++)
+	{
+		std::uint8_t rowCount = counters[index(hash, row)].load(std::memory_order_relaxed);
+		if(rowCount < count)
+		{
+			count = rowCount;
+		}
+	}
+	return count;
+}
+
+void FrequencySketch::age()
+{
+	for (std::uint32_t i = 0; i < DEPTH * width; i++)
+	{
+		counters[i].store(counters[i].load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+	}
+	additions.fetch_sub(sampleSize / 2, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,97 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+* @brief Approximate access counts of pages, the Count-Min sketch of TinyLFU (Einziger, Friedman and Manes).
+*
+* Every key has one small saturating counter in each of DEPTH rows. An access increments them all and
+* the estimate is their minimum, so hash collisions can only overestimate. Once a sample of accesses
+* proportional to the pool size has been counted, all counters are halved, so the sketch tracks recent
+* popularity rather than all-time counts.
+*
+* Counters are updated with relaxed atomics and no latch. Concurrent increments may occasionally be lost,
+* which only makes the estimate a little less exact.
+*/
+class FrequencySketch
+{
+ private:
+	/**
+   * Number of counter rows
+	 */
+  static const std::uint32_t DEPTH = 4;
+
+	/**
+   * Counters saturate at this value, as 4-bit counters would
+	 */
+  static const std::uint8_t MAX_COUNT = 15;
+
+	/**
+   * Counters per row, a power of two
+	 */
+  std::uint32_t width;
+
+	/**
+   * Number of counted accesses after which the counters are halved
+	 */
+  std::uint32_t sampleSize;
+
+	/**
+   * DEPTH rows of width counters
+	 */
+  std::atomic<std::uint8_t>* counters;
+
+	/**
+   * Accesses counted since the counters were last halved
+	 */
+  std::atomic<std::uint32_t> additions;
+
+	/**
+	 * Returns the index in counters of the counter for hash in row.
+	 */
+  std::uint32_t index(const std::uint64_t hash, const std::uint32_t row) const;
+
+	/**
+	 * Halves every counter.
+	 */
+  void age();
+
+ public:
+	/**
+   * Constructor of FrequencySketch class
+	 *
+	 * @param frames	Number of frames in the buffer pool
+	 */
+  FrequencySketch(const std::uint32_t frames);
+
+	/**
+   * Destructor of FrequencySketch class
+	 */
+  ~FrequencySketch();
+
+	/**
+	 * Counts one access to the key with the given hash.
+	 *
+	 * @param hash	Well mixed 64-bit hash of the key, e.g. PageTable::hashKey()
+	 */
+  void increment(const std::uint64_t hash);
+
+	/**
+	 * Returns the estimated number of recent accesses to the key with the given hash.
+	 *
+	 * @param hash	Well mixed 64-bit hash of the key
+	 */
+  std::uint32_t estimate(const std::uint64_t hash) const;
+};
+
+}
@@ -0,0 +1,292 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "ioEngine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace badgerdb {
+
+IoEngine::IoEngine(const std::uint32_t queueDepth)
+	: ringFd(-1), sqEntries(0), cqEntries(0), sqRing(NULL), sqRingSize(0), cqRing(NULL), cqRingSize(0),
+		sqes(NULL), inFlight(0), unsubmitted(0), stopping(false)
+{
+	struct io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	int fd = syscall(__NR_io_uring_setup, std::max<std::uint32_t>(queueDepth, 1), &params);
+	//Without io_uring every request is carried out synchronously
+	if(fd < 0)
+	{
+		return;
+	}
+	ringFd = fd;
+	if(mapRings(&params))
+	{
+		reaper = std::thread(&IoEngine::reapLoop, this);
+	}
+}
+
+IoEngine::~IoEngine()
+{
+	if(ringFd < 0)
+	{
+		submit();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		stopping = true;
+		//The no-op wakes the reaper up even if nothing else is in flight
+		pending.push_back(NULL);
+		submitPending();
+	}
+	reaper.join();
+	closeRing();
+}
+
+bool IoEngine::mapRings(const void* params)
+{
+	const struct io_uring_params* p = static_cast<const struct io_uring_params*>(params);
+	sqEntries = p->sq_entries;
+	cqEntries = p->cq_entries;
+	sqRingSize = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	cqRingSize = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	const bool singleMap = p->features & IORING_FEAT_SINGLE_MMAP;
+	if(singleMap)
+	{
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	}
+
+	void* mapped = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+		IORING_OFF_SQ_RING);
+	if(mapped == MAP_FAILED)
+	{
+		closeRing();
+		return false;
+	}
+	sqRing = mapped;
+	if(singleMap)
+	{
+		cqRing = sqRing;
+	}
+	else
+	{
+		mapped = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+			IORING_OFF_CQ_RING);
+		if(mapped == MAP_FAILED)
+		{
+			closeRing();
+			return false;
+		}
+		cqRing = mapped;
+	}
+	mapped = mmap(NULL, sqEntries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if(mapped == MAP_FAILED)
+	{
+		closeRing();
+		return false;
+	}
+	sqes = static_cast<struct io_uring_sqe*>(mapped);
+
+	char* sq = static_cast<char*>(sqRing);
+	sqHead = reinterpret_cast<unsigned*>(sq + p->sq_off.head);
+	sqTail = reinterpret_cast<unsigned*>(sq + p->sq_off.tail);
+	sqMask = reinterpret_cast<unsigned*>(sq + p->sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned*>(sq + p->sq_off.array);
+	char* cq = static_cast<char*>(cqRing);
+	cqHead = reinterpret_cast<unsigned*>(cq + p->cq_off.head);
+	cqTail = reinterpret_cast<unsigned*>(cq + p->cq_off.tail);
+	cqMask = reinterpret_cast<unsigned*>(cq + p->cq_off.ring_mask);
+	cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p->cq_off.cqes);
+	return true;
+}
+
+void IoEngine::closeRing()
+{
+	if(sqes)
+	{
+		munmap(sqes, sqEntries * sizeof(struct io_uring_sqe));
+	}
+	if(cqRing && cqRing != sqRing)
+	{
+		munmap(cqRing, cqRingSize);
+	}
+	if(sqRing)
+	{
+		munmap(sqRing, sqRingSize);
+	}
+	sqes = NULL;
+	sqRing = cqRing = NULL;
+	close(ringFd);
+	ringFd = -1;
+}
+
+void IoEngine::prepare(const int fd, const struct iovec* iov, const int count, const off_t offset,
+	const bool write, const Completion& done)
+{
+	Request* request = new Request;
+	request->fd = fd;
+	request->write = write;
+	request->offset = offset;
+	request->iov.assign(iov, iov + count);
+	request->done = done;
+	std::lock_guard<std::mutex> guard(latch);
+	pending.push_back(request);
+}
+
+std::size_t IoEngine::pendingCount()
+{
+	std::lock_guard<std::mutex> guard(latch);
+	return pending.size();
+}
+
+void IoEngine::submit()
+{
+	if(ringFd >= 0)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		submitPending();
+		return;
+	}
+
+	std::deque<Request*> batch;
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		batch.swap(pending);
+	}
+	for(std::size_t i = 0; i < batch.size(); i++)
+	{
+		batch[i]->done(perform(batch[i]));
+		delete batch[i];
+	}
+}
+
+void IoEngine::submitPending()
+{
+	unsigned tail = *sqTail;
+	const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	//Entries a previous call left in the ring go in with ours
+	unsigned toSubmit = unsubmitted;
+	//Never more in flight than the completion ring holds
+	while(!pending.empty() && tail - head < sqEntries && inFlight < cqEntries)
+	{
+		Request* request = pending.front();
+		pending.pop_front();
+		const unsigned index = tail & *sqMask;
+		struct io_uring_sqe* sqe = &sqes[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		if(request == NULL)
+		{
+			sqe->opcode = IORING_OP_NOP;
+		}
+		else
+		{
+			sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+			sqe->fd = request->fd;
+			sqe->addr = reinterpret_cast<std::uint64_t>(&request->iov[0]);
+			sqe->len = request->iov.size();
+			sqe->off = request->offset;
+		}
+		sqe->user_data = reinterpret_cast<std::uint64_t>(request);
+		sqArray[index] = index;
+		tail++;
+		toSubmit++;
+		inFlight++;
+	}
+	__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+	while(toSubmit > 0)
+	{
+		int submitted = syscall(__NR_io_uring_enter, ringFd, toSubmit, 0, 0, NULL, 0);
+		if(submitted < 0 && (errno == EINTR || errno == EAGAIN))
+		{
+			continue;
+		}
+		//The kernel takes the rest on the next call, which counts them in
+		if(submitted <= 0)
+		{
+			break;
+		}
+		toSubmit -= submitted;
+	}
+	unsubmitted = toSubmit;
+}
+
+void IoEngine::reapLoop()
+{
+	std::vector<std::pair<Request*, ssize_t> > completed;
+	while(true)
+	{
+		{
+			std::lock_guard<std::mutex> guard(latch);
+			if(stopping && inFlight == 0 && pending.empty())
+			{
+				return;
+			}
+		}
+		int entered = syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if(entered < 0 && errno != EINTR)
+		{
+			//Nothing can complete any more
+			return;
+		}
+
+		unsigned head = *cqHead;
+		const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+		completed.clear();
+		while(head != tail)
+		{
+			const struct io_uring_cqe* cqe = &cqes[head & *cqMask];
+			completed.push_back(std::make_pair(reinterpret_cast<Request*>(cqe->user_data), (ssize_t)cqe->res));
+			head++;
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		{
+			//Requests beyond the queue depth take the slots just freed
+			std::lock_guard<std::mutex> guard(latch);
+			inFlight -= completed.size();
+			submitPending();
+		}
+
+		for(std::size_t i = 0; i < completed.size(); i++)
+		{
+			Request* request = completed[i].first;
+			if(request)
+			{
+				request->done(completed[i].second);
+				delete request;
+			}
+		}
+	}
+}
+
+ssize_t IoEngine::perform(Request* request)
+{
+	while(true)
+	{
+		ssize_t result = request->write
+			? pwritev(request->fd, &request->iov[0], request->iov.size(), request->offset)
+			: preadv(request->fd, &request->iov[0], request->iov.size(), request->offset);
+		if(result >= 0)
+		{
+			return result;
+		}
+		if(errno != EINTR)
+		{
+			return -errno;
+		}
+	}
+}
+
+}
@@ -0,0 +1,202 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace badgerdb {
+
+/**
+* @brief Asynchronous vectored reads and writes through a Linux io_uring.
+*
+* Requests are queued by prepare() and handed to the kernel together by submit(), one system call for the
+* whole batch, so a single thread can keep many reads in flight. A background thread reaps completions and
+* runs each request's completion callback. The ring is driven through the raw system calls, so liburing is
+* not needed.
+*
+* If the kernel has no io_uring or refuses to set one up, every request is carried out synchronously with
+* preadv/pwritev by submit() instead, and its callback runs on the submitting thread.
+*/
+class IoEngine
+{
+ public:
+	/**
+	 * Called once a request completes, with the number of bytes transferred or a negated errno value. Runs on
+	 * the completion thread and must not wait for other requests of the same engine to complete.
+	 */
+  typedef std::function<void(const ssize_t result)> Completion;
+
+ private:
+	/**
+	 * A queued or submitted request
+	 */
+  struct Request
+	{
+	  int fd;
+	  bool write;
+	  off_t offset;
+	  std::vector<struct iovec> iov;
+	  Completion done;
+	};
+
+	/**
+   * Descriptor of the ring, -1 without io_uring
+	 */
+  int ringFd;
+
+	/**
+   * Number of submission queue entries
+	 */
+  std::uint32_t sqEntries;
+
+	/**
+   * Number of completion queue entries, no more requests are in flight at once
+	 */
+  std::uint32_t cqEntries;
+
+	/**
+   * Mapped submission and completion rings, and their lengths
+	 */
+  void* sqRing;
+  std::size_t sqRingSize;
+  void* cqRing;
+  std::size_t cqRingSize;
+
+	/**
+   * Mapped submission queue entries
+	 */
+  io_uring_sqe* sqes;
+
+	/**
+   * Fields of the submission ring, shared with the kernel
+	 */
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+
+	/**
+   * Fields of the completion ring, shared with the kernel
+	 */
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  io_uring_cqe* cqes;
+
+	/**
+   * Protects the members below and the submission ring
+	 */
+  std::mutex latch;
+
+	/**
+   * Requests prepared but not yet handed to the kernel, NULL for a no-op that wakes the reaper
+	 */
+  std::deque<Request*> pending;
+
+	/**
+   * Requests handed to the kernel and not yet reaped
+	 */
+  std::uint32_t inFlight;
+
+	/**
+   * Entries placed in the submission ring that the kernel has not taken yet
+	 */
+  std::uint32_t unsubmitted;
+
+	/**
+   * True once the engine is being destroyed
+	 */
+  bool stopping;
+
+	/**
+   * Thread reaping completions
+	 */
+  std::thread reaper;
+
+	/**
+	 * Maps the rings of ringFd. Returns false, with everything unmapped again, if that fails.
+	 */
+  bool mapRings(const void* params);
+
+	/**
+	 * Unmaps the rings and closes ringFd.
+	 */
+  void closeRing();
+
+	/**
+	 * Moves as many pending requests into the submission ring as fit and enters them. Called with latch held.
+	 */
+  void submitPending();
+
+	/**
+	 * Body of the reaper thread
+	 */
+  void reapLoop();
+
+	/**
+	 * Carries out a request synchronously and returns its result.
+	 */
+  static ssize_t perform(Request* request);
+
+ public:
+	/**
+   * Constructor of IoEngine class
+	 *
+	 * @param queueDepth	Number of requests the kernel is handed at most at once
+	 */
+  IoEngine(const std::uint32_t queueDepth = 64);
+
+	/**
+   * Destructor of IoEngine class. Submits any requests still pending and waits for all to complete.
+	 */
+  ~IoEngine();
+
+	/**
+	 * Returns true if requests go through an io_uring, false if they are carried out synchronously.
+	 */
+  bool isAsync() const
+	{
+		return ringFd >= 0;
+	}
+
+	/**
+	 * Queues a vectored read or write. The buffers must stay valid until the request completes.
+	 *
+	 * @param fd     	Descriptor of the file
+	 * @param iov    	Buffers, copied
+	 * @param count  	Number of buffers
+	 * @param offset 	Position in the file of the first byte
+	 * @param write  	True to write, false to read
+	 * @param done   	Called once the request completes
+	 */
+  void prepare(const int fd, const struct iovec* iov, const int count, const off_t offset, const bool write,
+							 const Completion& done);
+
+	/**
+	 * Hands all prepared requests to the kernel in one call. Requests that exceed the queue depth follow as
+	 * earlier ones complete.
+	 */
+  void submit();
+
+	/**
+	 * Returns the number of requests prepared but not yet handed to the kernel.
+	 */
+  std::size_t pendingCount();
+};
+
+}
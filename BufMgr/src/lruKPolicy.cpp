@@ -0,0 +1,207 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "lruKPolicy.h"
+#include "pageTable.h"
+
+namespace badgerdb {
+
+LruKPolicy::LruKPolicy(const std::uint32_t frames, const std::uint32_t historyPages,
+											 const std::uint32_t refsKept, const std::uint64_t correlatedTicks,
+											 const std::uint32_t samples)
+	: numFrames(frames), k(refsKept > 0 ? refsKept : 1), historySize(historyPages),
+		correlatedPeriod(correlatedTicks), victimSamples(samples > 0 ? samples : 1), clock(0), sampleSeed(0),
+		historySeq(0)
+{
+	refTimes = new std::atomic<std::uint64_t>[(std::size_t)frames * k];
+	for (FrameId i = 0; i < frames; i++)
+	{
+		resetFrame(i);
+	}
+}
+
+LruKPolicy::~LruKPolicy()
+{
+	delete [] refTimes;
+}
+
+LruKPolicy::VictimKey LruKPolicy::victimKey(const FrameId frameNo) const
+{
+	const std::atomic<std::uint64_t>* times = &refTimes[(std::size_t)frameNo * k];
+	return VictimKey(times[k - 1].load(std::memory_order_relaxed), times[0].load(std::memory_order_relaxed),
+									 frameNo);
+}
+
+void LruKPolicy::reference(const FrameId frameNo)
+{
+	std::atomic<std::uint64_t>* times = &refTimes[(std::size_t)frameNo * k];
+	std::uint64_t now = clock.fetch_add(1, std::memory_order_relaxed) + 1;
+	std::uint64_t last = times[0].load(std::memory_order_relaxed);
+	//A correlated reference only moves the most recent time forward
+	if(last != 0 && now - last <= correlatedPeriod)
+	{
+		times[0].store(now, std::memory_order_relaxed);
+		return;
+	}
+	for (std::uint32_t i = k - 1; i > 0; i--)
+	{
+		times[i].store(times[i - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	times[0].store(now, std::memory_order_relaxed);
+}
+
+void LruKPolicy::resetFrame(const FrameId frameNo)
+{
+	std::atomic<std::uint64_t>* times = &refTimes[(std::size_t)frameNo * k];
+	for (std::uint32_t i = 0; i < k; i++)
+	{
+		times[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void LruKPolicy::recordAccess(const FrameId frameNo)
+{
+	reference(frameNo);
+}
+
+void LruKPolicy::recordLoad(const FrameId frameNo, const File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	std::unordered_map<std::uint64_t, RetainedHistory>::iterator retained =
+		history.find(PageTable::packKey(file, pageNo));
+	if(retained != history.end())
+	{
+		std::atomic<std::uint64_t>* times = &refTimes[(std::size_t)frameNo * k];
+		for (std::uint32_t i = 0; i < k; i++)
+		{
+			times[i].store(retained->second.times[i], std::memory_order_relaxed);
+		}
+		history.erase(retained);
+	}
+	else
+	{
+		resetFrame(frameNo);
+	}
+	reference(frameNo);
+}
+
+void LruKPolicy::recordUnpin(const FrameId frameNo)
+{
+}
+
+void LruKPolicy::recordEviction(const FrameId frameNo, const File* file, const PageId pageNo)
+{
+	std::lock_guard<std::mutex> guard(latch);
+	if(historySize > 0)
+	{
+		std::uint64_t key = PageTable::packKey(file, pageNo);
+		RetainedHistory& retained = history[key];
+		retained.seq = historySeq++;
+		const std::atomic<std::uint64_t>* times = &refTimes[(std::size_t)frameNo * k];
+		retained.times.resize(k);
+		for (std::uint32_t i = 0; i < k; i++)
+		{
+			retained.times[i] = times[i].load(std::memory_order_relaxed);
+		}
+		historyOrder.push_back(std::make_pair(key, retained.seq));
+
+		//Drop the oldest entries, skipping ones already reloaded or re-evicted
+		while(history.size() > historySize || historyOrder.size() > 2 * (std::size_t)historySize)
+		{
+			std::pair<std::uint64_t, std::uint64_t> oldest = historyOrder.front();
+			historyOrder.pop_front();
+			std::unordered_map<std::uint64_t, RetainedHistory>::iterator entry = history.find(oldest.first);
+			if(entry != history.end() && entry->second.seq == oldest.second)
+			{
+				history.erase(entry);
+			}
+		}
+	}
+	resetFrame(frameNo);
+}
+
+void LruKPolicy::recordFree(const FrameId frameNo)
+{
+	resetFrame(frameNo);
+}
+
+void LruKPolicy::sampleKeys(std::vector<VictimKey>& keys, const std::uint32_t count)
+{
+	if(count >= numFrames)
+	{
+		for (FrameId i = 0; i < numFrames; i++)
+		{
+			keys.push_back(victimKey(i));
+		}
+		return;
+	}
+	std::uint64_t seed = sampleSeed.fetch_add(count, std::memory_order_relaxed);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		//splitmix64 of consecutive seeds
+		std::uint64_t z = (seed + i) * 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z ^= z >> 31;
+		keys.push_back(victimKey((FrameId)(z % numFrames)));
+	}
+}
+
+bool LruKPolicy::pickVictim(FrameId& frameNo, const EvictablePredicate& evictable)
+{
+	std::vector<VictimKey> keys;
+	keys.reserve(std::min(victimSamples, numFrames));
+	sampleKeys(keys, victimSamples);
+	//The predicate costs more than the key, so it is asked in victim order and only until it says yes
+	std::sort(keys.begin(), keys.end());
+	for (std::size_t i = 0; i < keys.size(); i++)
+	{
+		if(evictable(std::get<2>(keys[i])))
+		{
+			frameNo = std::get<2>(keys[i]);
+			return true;
+		}
+	}
+	if(keys.size() == numFrames)
+	{
+		return false;
+	}
+	//Every frame sampled is pinned; only a full scan can tell whether the pool is
+	bool found = false;
+	VictimKey best;
+	for (FrameId i = 0; i < numFrames; i++)
+	{
+		VictimKey key = victimKey(i);
+		if((!found || key < best) && evictable(i))
+		{
+			best = key;
+			found = true;
+		}
+	}
+	if(found)
+	{
+		frameNo = std::get<2>(best);
+	}
+	return found;
+}
+
+void LruKPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count)
+{
+	std::vector<VictimKey> keys;
+	sampleKeys(keys, std::max(victimSamples, 4 * count));
+	//A frame sampled twice is listed once
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	const std::size_t listed = std::min<std::size_t>(count, keys.size());
+	for (std::size_t i = 0; i < listed; i++)
+	{
+		frames.push_back(std::get<2>(keys[i]));
+	}
+}
+
+}
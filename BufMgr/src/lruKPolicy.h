@@ -0,0 +1,192 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "replacementPolicy.h"
+
+namespace badgerdb {
+
+/**
+* @brief The LRU-K replacement policy (O'Neil, O'Neil and Weikum), LRU-2 by default.
+*
+* Every frame remembers the logical times of the last K references to its page. The victim is the unpinned
+* frame whose K-th most recent reference lies furthest back; pages referenced fewer than K times count as
+* infinitely far back and are evicted first, least recently used first. A page touched once by a sequential
+* scan therefore goes before an index page that is referenced over and over.
+*
+* The reference times of evicted pages are retained in a bounded history, so a page that is read in again
+* soon after its eviction keeps its standing instead of starting over as a one-time reference.
+*
+* Pins of resident pages only update the reference times of their frame, in a fixed array, without any
+* latch. No index is kept in victim order; like Redis's approximated LRU, pickVictim() compares the reference
+* times of a bounded random sample of frames and evicts the best of them, so a miss costs the same in any
+* pool size. Pools no larger than the sample are scanned whole, in exact LRU-K order. Only the history of
+* evicted pages is behind a latch.
+*/
+class LruKPolicy : public ReplacementPolicy
+{
+ private:
+	/**
+	 * Victim order of a frame, smallest first: K-th most recent reference time (0 if fewer than K
+	 * references), most recent reference time, frame number
+	 */
+  typedef std::tuple<std::uint64_t, std::uint64_t, FrameId> VictimKey;
+
+	/**
+	 * Reference times of an evicted page
+	 */
+  struct RetainedHistory
+	{
+		/**
+	   * Position of the page in historyOrder
+		 */
+	  std::uint64_t seq;
+
+		/**
+	   * Last K reference times, most recent first
+		 */
+	  std::vector<std::uint64_t> times;
+	};
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numFrames;
+
+	/**
+   * Number of references remembered per page
+	 */
+  std::uint32_t k;
+
+	/**
+   * Maximum number of evicted pages whose history is retained
+	 */
+  std::uint32_t historySize;
+
+	/**
+   * References to the same page at most this many ticks apart are correlated, e.g. the repeated pins of one
+   * operation, and count as a single reference
+	 */
+  std::uint64_t correlatedPeriod;
+
+	/**
+   * Number of frames pickVictim() compares
+	 */
+  std::uint32_t victimSamples;
+
+	/**
+   * Logical time, advanced on every reference
+	 */
+  std::atomic<std::uint64_t> clock;
+
+	/**
+   * Advanced by every sample, the frames sampled are derived from it
+	 */
+  std::atomic<std::uint64_t> sampleSeed;
+
+	/**
+   * Last K reference times of every frame, most recent first, K entries per frame. 0 means no reference.
+   * Pins of one page may update its entries concurrently; a reference lost that way only blurs the order.
+	 */
+  std::atomic<std::uint64_t>* refTimes;
+
+	/**
+   * Protects the history below
+	 */
+  std::mutex latch;
+
+	/**
+   * Reference times of recently evicted pages, by PageTable::packKey()
+	 */
+  std::unordered_map<std::uint64_t, RetainedHistory> history;
+
+	/**
+   * Keys and sequence numbers of the entries of history, oldest first. An entry whose sequence number no
+   * longer matches has been taken back out of the history.
+	 */
+  std::deque<std::pair<std::uint64_t, std::uint64_t> > historyOrder;
+
+	/**
+   * Sequence number of the next history entry
+	 */
+  std::uint64_t historySeq;
+
+	/**
+	 * Returns the victim order of frameNo.
+	 */
+  VictimKey victimKey(const FrameId frameNo) const;
+
+	/**
+	 * Records a reference to the page in frameNo at the next logical time.
+	 */
+  void reference(const FrameId frameNo);
+
+	/**
+	 * Forgets the reference times of frameNo, making it the best victim.
+	 */
+  void resetFrame(const FrameId frameNo);
+
+	/**
+	 * Appends the victim order of count frames to keys: all frames if count is at least the pool size,
+	 * otherwise frames picked at random, possibly some twice.
+	 */
+  void sampleKeys(std::vector<VictimKey>& keys, const std::uint32_t count);
+
+ public:
+	/**
+   * Constructor of LruKPolicy class
+	 *
+	 * @param frames					Number of frames in the buffer pool
+	 * @param historyPages		Number of evicted pages whose reference times are retained
+	 * @param refsKept				K, the number of references remembered per page
+	 * @param correlatedTicks	References to one page at most this many references apart count as one
+	 * @param samples					Number of frames compared to pick a victim
+	 */
+  LruKPolicy(const std::uint32_t frames, const std::uint32_t historyPages, const std::uint32_t refsKept = 2,
+						 const std::uint64_t correlatedTicks = 0, const std::uint32_t samples = 32);
+
+	/**
+   * Destructor of LruKPolicy class
+	 */
+  ~LruKPolicy();
+
+  void recordAccess(const FrameId frameNo);
+
+	/**
+	 * Restores the reference times of the page if they are still in the history, then records the reference.
+	 */
+  void recordLoad(const FrameId frameNo, const File* file, const PageId pageNo);
+
+  void recordUnpin(const FrameId frameNo);
+
+	/**
+	 * Moves the reference times of the evicted page into the history, dropping the oldest entry when it is full.
+	 */
+  void recordEviction(const FrameId frameNo, const File* file, const PageId pageNo);
+
+  void recordFree(const FrameId frameNo);
+
+	/**
+	 * Returns the unpinned frame first in victim order among a sample of frames. Scans all frames only if
+	 * none of the sample is unpinned.
+	 */
+  bool pickVictim(FrameId& frameNo, const EvictablePredicate& evictable);
+
+	/**
+	 * Returns the first count frames in victim order among a sample of at least four times as many frames.
+	 */
+  void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count);
+};
+
+}
@@ -3,8 +3,18 @@
 //#include <stdio.h>
 #include <cstring>
 #include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "page.h"
 #include "buffer.h"
+#include "clockPolicy.h"
+#include "lruKPolicy.h"
+#include "arcPolicy.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
 #include "exceptions/file_not_found_exception.h"
@@ -12,6 +22,8 @@
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/invalid_record_exception.h"
+#include "exceptions/read_only_file_exception.h"
 using namespace std;
 #define PRINT_ERROR(str) \
 { \
@@ -36,6 +48,29 @@ void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
 void testBufMgr();
 
 int main()
@@ -74,12 +109,14 @@ int main()
     for (FileIterator iter = new_file.begin();
          iter != new_file.end();
          ++iter) {
-      // Iterate through all records on the page.
-      for (PageIterator page_iter = (*iter).begin();
-           page_iter != (*iter).end();
+      // Iterate through all records on the page.  The iterator hands out
+      // copies, so keep one alive while its records are walked.
+      Page current_page = *iter;
+      for (PageIterator page_iter = current_page.begin();
+           page_iter != current_page.end();
            ++page_iter) {
         std::cout << "Found record: " << *page_iter
-            << " on page " << (*iter).page_number() << "\n";
+            << " on page " << current_page.page_number() << "\n";
       }
     }
 
@@ -146,6 +183,29 @@ void testBufMgr()
 	 test4();
 	 test5();
 	 test6();
+	 test7();
+	 test8();
+	 test9();
+	 test10();
+	 test11();
+	 test12();
+	 test13();
+	 test14();
+	 test15();
+	 test16();
+	 test17();
+	 test18();
+	 test19();
+	 test20();
+	 test21();
+	 test22();
+	 test23();
+	 test24();
+	 test25();
+	 test26();
+	 test27();
+	 test28();
+	 test29();
 
 	delete bufMgr;
 
@@ -324,4 +384,1601 @@ void test6()
 
 	bufMgr->flushFile(file1ptr);
 }
-//Flushing pages with bad data
+void test7()
+{
+	//Several threads reading file1 through a pool much smaller than the file,
+	//so hits, misses and evictions race with each other
+	BufMgr concurrentMgr(num/5, 8);
+	std::atomic<int> mismatches(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < 4; t++)
+	{
+		workers.push_back(std::thread([&concurrentMgr, &mismatches, t]()
+		{
+			char buf[100];
+			Page* p;
+			for (PageId k = 0; k < 5 * num; k++)
+			{
+				PageId pageNo = (k * (t + 1)) % num + 1;
+				concurrentMgr.readPage(file1ptr, pageNo, p);
+				sprintf(buf, "test.1 Page %d %7.1f", pageNo, (float)pageNo);
+				RecordId recordId = {pageNo, 1};
+				if(strncmp(p->getRecord(recordId).c_str(), buf, strlen(buf)) != 0)
+				{
+					mismatches++;
+				}
+				concurrentMgr.unPinPage(file1ptr, pageNo, false);
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	if(mismatches != 0)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+
+	//Threads allocating pages of one file wait for each other on that file
+	const std::string& sharedName = "test.7";
+	const PageId pagesPerThread = 10;
+	{
+		File shared = File::create(sharedName);
+		std::vector<std::thread> allocators;
+		for (int t = 0; t < 4; t++)
+		{
+			allocators.push_back(std::thread([&concurrentMgr, &shared, pagesPerThread]()
+			{
+				PageId pageNo;
+				Page* p;
+				for (PageId k = 0; k < pagesPerThread; k++)
+				{
+					concurrentMgr.allocPage(&shared, pageNo, p);
+					p->insertRecord("shared");
+					concurrentMgr.unPinPage(&shared, pageNo, true);
+				}
+			}));
+		}
+		for (std::size_t t = 0; t < allocators.size(); t++)
+			allocators[t].join();
+		concurrentMgr.flushFile(&shared);
+
+		PageId listed = 0;
+		for (FileIterator iter = shared.begin(); iter != shared.end(); ++iter)
+		{
+			listed++;
+		}
+		if(listed != 4 * pagesPerThread)
+		{
+			PRINT_ERROR("ERROR :: Concurrent allocations lost pages of the file.");
+		}
+
+		//Only a page in the pool is disposed of; the flush above took them all out
+		concurrentMgr.disposePage(&shared, (*shared.begin()).page_number());
+		listed = 0;
+		for (FileIterator iter = shared.begin(); iter != shared.end(); ++iter)
+		{
+			listed++;
+		}
+		if(listed != 4 * pagesPerThread)
+		{
+			PRINT_ERROR("ERROR :: Page not in the buffer pool was deleted from the file.");
+		}
+	}
+	File::remove(sharedName);
+
+	std::cout << "Test 7 passed" << "\n";
+}
+
+void test8()
+{
+	//Misses and errors reported through status codes instead of exceptions
+	if(bufMgr->tryReadPage(file4ptr, 2, page) != BufStatus::INVALID_PAGE)
+	{
+		PRINT_ERROR("ERROR :: Page 2 of file4 was never allocated, tryReadPage should have failed.");
+	}
+	if(bufMgr->tryUnpin(file4ptr, 2, false) != BufStatus::NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: Page 2 of file4 is not in the buffer pool.");
+	}
+	if(bufMgr->tryReadPage(file4ptr, 1, page) != BufStatus::OK
+		|| bufMgr->tryUnpin(file4ptr, 1, false) != BufStatus::OK)
+	{
+		PRINT_ERROR("ERROR :: Reading and unpinning page 1 of file4 should have succeeded.");
+	}
+	if(bufMgr->tryUnpin(file4ptr, 1, false) != BufStatus::NOT_PINNED)
+	{
+		PRINT_ERROR("ERROR :: Page is already unpinned, tryUnpin should have failed.");
+	}
+
+	//A dirty page of a file opened read-only cannot be written back, so the miss evicting it fails
+	const std::string& filename = "test.6";
+	PageId pageNos[2];
+	{
+		File created = File::create(filename);
+		for (int k = 0; k < 2; k++)
+		{
+			Page added = created.allocatePage();
+			pageNos[k] = added.page_number();
+			created.writePage(added);
+		}
+	}
+	{
+		File readOnly = File::openMapped(filename);
+		BufMgr failingMgr(1);
+		failingMgr.readPage(&readOnly, pageNos[0], page);
+		failingMgr.unPinPage(&readOnly, pageNos[0], true);
+		if(failingMgr.tryReadPage(&readOnly, pageNos[1], page) != BufStatus::IO_ERROR)
+		{
+			PRINT_ERROR("ERROR :: Writing back to a read-only file failed, tryReadPage should have too.");
+		}
+		try
+		{
+			failingMgr.readPage(&readOnly, pageNos[1], page);
+			PRINT_ERROR("ERROR :: Writing back to a read-only file failed. Exception should have been thrown before execution reaches this point.");
+		}
+		catch(const ReadOnlyFileException&)
+		{
+		}
+		failingMgr.dropFile(&readOnly);
+	}
+	File::remove(filename);
+
+	std::cout << "Test 8 passed" << "\n";
+}
+
+void test9()
+{
+	//Pages written through guards are marked dirty and unpinned when the
+	//guards go away, including guards that were moved around
+	{
+		std::vector<WritePageGuard> guards;
+		for (i = 1; i <= num; i++)
+		{
+			WritePageGuard guard = bufMgr->writePageGuarded(file1ptr, i);
+			guard->insertRecord("guarded");
+			guards.push_back(std::move(guard));
+			if(guard.isValid())
+			{
+				PRINT_ERROR("ERROR :: A moved-from guard should not hold a pin.");
+			}
+		}
+	}
+	//Throws PagePinnedException if any guard leaked its pin
+	bufMgr->flushFile(file1ptr);
+
+	for (i = 1; i <= num; i++)
+	{
+		ReadPageGuard guard;
+		guard = bufMgr->readPageGuarded(file1ptr, i);
+		RecordId recordId = {i, 2};
+		if(guard->getRecord(recordId) != "guarded")
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+	bufMgr->flushFile(file1ptr);
+
+	std::cout << "Test 9 passed" << "\n";
+}
+
+void test10()
+{
+	//Pages referenced twice outlive a one-pass scan under LRU-2, which only
+	//ever evicts the scanned pages since they were each referenced once
+	const std::uint32_t frames = 10;
+	const PageId hotPages = 5;
+	BufMgr lruMgr(frames, 1, new LruKPolicy(frames, frames));
+	for (int round = 0; round < 2; round++)
+	{
+		for (i = 1; i <= hotPages; i++)
+		{
+			lruMgr.readPage(file1ptr, i, page);
+			lruMgr.unPinPage(file1ptr, i, false);
+		}
+	}
+	for (i = hotPages + 1; i <= num; i++)
+	{
+		lruMgr.readPage(file1ptr, i, page);
+		lruMgr.unPinPage(file1ptr, i, false);
+	}
+
+	lruMgr.clearBufStats();
+	for (i = 1; i <= hotPages; i++)
+	{
+		lruMgr.readPage(file1ptr, i, page);
+		lruMgr.unPinPage(file1ptr, i, false);
+	}
+	if(lruMgr.getBufStats().accesses != (int)hotPages || lruMgr.getBufStats().diskreads != 0)
+	{
+		PRINT_ERROR("ERROR :: Scan evicted pages referenced more often.");
+	}
+
+	//The policy still reports a full pool
+	for (i = 1; i <= frames; i++)
+	{
+		lruMgr.readPage(file1ptr, i, page);
+	}
+	try
+	{
+		lruMgr.readPage(file1ptr, frames + 1, page);
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException&)
+	{
+	}
+	for (i = 1; i <= frames; i++)
+	{
+		lruMgr.unPinPage(file1ptr, i, false);
+	}
+
+	//A pool larger than the sample still finds its one unpinned frame
+	const std::uint32_t sampledFrames = 64;
+	BufMgr sampledMgr(sampledFrames, 1, new LruKPolicy(sampledFrames, sampledFrames, 2, 0, 4));
+	for (i = 1; i <= sampledFrames; i++)
+	{
+		sampledMgr.readPage(file1ptr, i, page);
+	}
+	sampledMgr.unPinPage(file1ptr, sampledFrames, false);
+	sampledMgr.readPage(file1ptr, sampledFrames + 1, page);
+	if(sampledMgr.tryUnpin(file1ptr, sampledFrames, false) != BufStatus::NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: Only unpinned page was not the one evicted.");
+	}
+	for (i = 1; i <= sampledFrames + 1; i++)
+	{
+		if(i != sampledFrames)
+		{
+			sampledMgr.unPinPage(file1ptr, i, false);
+		}
+	}
+
+	std::cout << "Test 10 passed" << "\n";
+}
+
+void test11()
+{
+	//Under ARC the twice-read pages sit in T2 and the scan only churns T1
+	const std::uint32_t frames = 10;
+	const PageId hotPages = 5;
+	{
+		BufMgr arcMgr(frames, 1, new ArcPolicy(frames));
+		for (int round = 0; round < 2; round++)
+		{
+			for (i = 1; i <= hotPages; i++)
+			{
+				arcMgr.readPage(file1ptr, i, page);
+				arcMgr.unPinPage(file1ptr, i, false);
+			}
+		}
+		for (i = hotPages + 1; i <= num; i++)
+		{
+			arcMgr.readPage(file1ptr, i, page);
+			arcMgr.unPinPage(file1ptr, i, false);
+		}
+
+		arcMgr.clearBufStats();
+		for (i = 1; i <= hotPages; i++)
+		{
+			arcMgr.readPage(file1ptr, i, page);
+			arcMgr.unPinPage(file1ptr, i, false);
+		}
+		if(arcMgr.getBufStats().diskreads != 0)
+		{
+			PRINT_ERROR("ERROR :: Scan evicted pages referenced more often.");
+		}
+	}
+
+	//Ghost hits and list moves racing between threads
+	BufMgr concurrentMgr(frames, 4, new ArcPolicy(frames));
+	std::atomic<int> mismatches(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < 4; t++)
+	{
+		workers.push_back(std::thread([&concurrentMgr, &mismatches, t]()
+		{
+			char buf[100];
+			Page* p;
+			for (PageId k = 0; k < 2 * num; k++)
+			{
+				//Each thread mixes a small hot set with a sweep over the file
+				PageId pageNo = k % 2 ? (k * (t + 1)) % num + 1 : k % 3 + 1;
+				concurrentMgr.readPage(file1ptr, pageNo, p);
+				sprintf(buf, "test.1 Page %d %7.1f", pageNo, (float)pageNo);
+				RecordId recordId = {pageNo, 1};
+				if(strncmp(p->getRecord(recordId).c_str(), buf, strlen(buf)) != 0)
+				{
+					mismatches++;
+				}
+				concurrentMgr.unPinPage(file1ptr, pageNo, false);
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	if(mismatches != 0)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+
+	std::cout << "Test 11 passed" << "\n";
+}
+
+void test12()
+{
+	//Scans and bulk loads through an access strategy only recycle their own
+	//ring (at most 24/8 frames here), so the hot pages stay in the pool
+	const PageId hotPages = 5;
+	const PageId bulkPages = 40;
+	BufMgr strategyMgr(24);
+	for (int round = 0; round < 2; round++)
+	{
+		for (i = 1; i <= hotPages; i++)
+		{
+			strategyMgr.readPage(file1ptr, i, page);
+			strategyMgr.unPinPage(file1ptr, i, false);
+		}
+	}
+
+	{
+		BufferAccessStrategy scan(StrategyType::BULKREAD);
+		for (i = 1; i <= num; i++)
+		{
+			strategyMgr.readPage(file1ptr, i, page, &scan);
+			sprintf(tmpbuf, "test.1 Page %d %7.1f", i, (float)i);
+			rid2.page_number = i;
+			rid2.slot_number = 1;
+			if(strncmp(page->getRecord(rid2).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+			}
+			strategyMgr.unPinPage(file1ptr, i, false);
+		}
+	}
+
+	PageId bulkPid[bulkPages];
+	{
+		BufferAccessStrategy load(StrategyType::BULKWRITE);
+		for (i = 0; i < bulkPages; i++)
+		{
+			strategyMgr.allocPage(file2ptr, bulkPid[i], page, &load);
+			sprintf(tmpbuf, "bulk.2 Page %d %7.1f", bulkPid[i], (float)bulkPid[i]);
+			page->insertRecord(tmpbuf);
+			strategyMgr.unPinPage(file2ptr, bulkPid[i], true);
+		}
+	}
+
+	strategyMgr.clearBufStats();
+	for (i = 1; i <= hotPages; i++)
+	{
+		strategyMgr.readPage(file1ptr, i, page);
+		strategyMgr.unPinPage(file1ptr, i, false);
+	}
+	if(strategyMgr.getBufStats().diskreads != 0)
+	{
+		PRINT_ERROR("ERROR :: Bulk access evicted pages outside its ring.");
+	}
+
+	//Pages written back while their ring frames were recycled read back intact
+	strategyMgr.flushFile(file2ptr);
+	BufferAccessStrategy check(StrategyType::BULKREAD);
+	for (i = 0; i < bulkPages; i++)
+	{
+		strategyMgr.readPage(file2ptr, bulkPid[i], page, &check);
+		sprintf(tmpbuf, "bulk.2 Page %d %7.1f", bulkPid[i], (float)bulkPid[i]);
+		rid2.page_number = bulkPid[i];
+		rid2.slot_number = 1;
+		if(strncmp(page->getRecord(rid2).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		strategyMgr.unPinPage(file2ptr, bulkPid[i], false);
+	}
+
+	std::cout << "Test 12 passed" << "\n";
+}
+
+void test13()
+{
+	//With admission on, a long tail of one-time pages is read into the
+	//probationary window and cannot displace the frequently read pages
+	const std::uint32_t frames = 10;
+	const PageId hotPages = 5;
+	BufMgr admissionMgr(frames);
+	admissionMgr.enableAdmission();
+	for (int round = 0; round < 8; round++)
+	{
+		for (i = 1; i <= hotPages; i++)
+		{
+			admissionMgr.readPage(file1ptr, i, page);
+			admissionMgr.unPinPage(file1ptr, i, false);
+		}
+	}
+	for (i = hotPages + 1; i <= num; i++)
+	{
+		admissionMgr.readPage(file1ptr, i, page);
+		sprintf(tmpbuf, "test.1 Page %d %7.1f", i, (float)i);
+		rid2.page_number = i;
+		rid2.slot_number = 1;
+		if(strncmp(page->getRecord(rid2).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		admissionMgr.unPinPage(file1ptr, i, false);
+	}
+
+	admissionMgr.clearBufStats();
+	for (i = 1; i <= hotPages; i++)
+	{
+		admissionMgr.readPage(file1ptr, i, page);
+		admissionMgr.unPinPage(file1ptr, i, false);
+	}
+	if(admissionMgr.getBufStats().diskreads != 0)
+	{
+		PRINT_ERROR("ERROR :: One-time pages were admitted over frequently read pages.");
+	}
+
+	std::cout << "Test 13 passed" << "\n";
+}
+
+void test14()
+{
+	//The cleaner writes dirty pages back in the background, so the misses
+	//that later evict them do not write anything themselves
+	const std::uint32_t frames = 20;
+	const PageId dirtyPages = 10;
+	BufMgr cleanerMgr(frames);
+	CleanerConfig config;
+	config.intervalMs = 1;
+	config.dirtyRatio = 0;
+	cleanerMgr.startCleaner(config);
+
+	PageId cleanPid[dirtyPages];
+	for (i = 0; i < dirtyPages; i++)
+	{
+		cleanerMgr.allocPage(file3ptr, cleanPid[i], page);
+		sprintf(tmpbuf, "clean.3 Page %d %7.1f", cleanPid[i], (float)cleanPid[i]);
+		page->insertRecord(tmpbuf);
+		cleanerMgr.unPinPage(file3ptr, cleanPid[i], true);
+	}
+	for (int wait = 0; wait < 5000 && cleanerMgr.getBufStats().cleanerwrites < (int)dirtyPages; wait++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if(cleanerMgr.getBufStats().cleanerwrites < (int)dirtyPages)
+	{
+		PRINT_ERROR("ERROR :: Cleaner did not write back the dirty pages.");
+	}
+
+	cleanerMgr.clearBufStats();
+	for (i = 1; i <= frames; i++)
+	{
+		cleanerMgr.readPage(file1ptr, i, page);
+		cleanerMgr.unPinPage(file1ptr, i, false);
+	}
+	if(cleanerMgr.getBufStats().diskwrites != 0)
+	{
+		PRINT_ERROR("ERROR :: A miss had to write back its victim.");
+	}
+	cleanerMgr.stopCleaner();
+
+	//The evicted pages come back from disk with what the cleaner wrote
+	for (i = 0; i < dirtyPages; i++)
+	{
+		cleanerMgr.readPage(file3ptr, cleanPid[i], page);
+		sprintf(tmpbuf, "clean.3 Page %d %7.1f", cleanPid[i], (float)cleanPid[i]);
+		rid2.page_number = cleanPid[i];
+		rid2.slot_number = 1;
+		if(strncmp(page->getRecord(rid2).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		cleanerMgr.unPinPage(file3ptr, cleanPid[i], false);
+	}
+
+	std::cout << "Test 14 passed" << "\n";
+}
+
+void test15()
+{
+	//A miss on a pool full of dirty pages evicts a whole batch, so the next
+	//misses take frames off the free-frame list without writing anything
+	const std::uint32_t frames = 10;
+	const std::uint32_t batch = 4;
+	BufMgr evictionMgr(frames);
+	EvictionConfig config;
+	config.batch = batch;
+	evictionMgr.configureEviction(config);
+	for (i = 1; i <= frames; i++)
+	{
+		evictionMgr.readPage(file1ptr, i, page);
+		evictionMgr.unPinPage(file1ptr, i, true);
+	}
+	evictionMgr.clearBufStats();
+	evictionMgr.readPage(file1ptr, frames + 1, page);
+	evictionMgr.unPinPage(file1ptr, frames + 1, false);
+	if(evictionMgr.getBufStats().diskwrites != (int)batch)
+	{
+		PRINT_ERROR("ERROR :: A miss did not evict a whole batch.");
+	}
+	evictionMgr.clearBufStats();
+	for (i = frames + 2; i <= frames + batch; i++)
+	{
+		evictionMgr.readPage(file1ptr, i, page);
+		evictionMgr.unPinPage(file1ptr, i, false);
+	}
+	if(evictionMgr.getBufStats().diskwrites != 0)
+	{
+		PRINT_ERROR("ERROR :: Misses evicted although frames were free.");
+	}
+
+	//Frames of disposed pages are handed out again before anything is evicted
+	PageId disposedPid;
+	evictionMgr.allocPage(file3ptr, disposedPid, page);
+	evictionMgr.unPinPage(file3ptr, disposedPid, true);
+	evictionMgr.clearBufStats();
+	evictionMgr.disposePage(file3ptr, disposedPid);
+	evictionMgr.readPage(file1ptr, frames + batch + 1, page);
+	evictionMgr.unPinPage(file1ptr, frames + batch + 1, false);
+	if(evictionMgr.getBufStats().diskwrites != 0)
+	{
+		PRINT_ERROR("ERROR :: A freed frame was not reused.");
+	}
+
+	//The background evictor keeps frames free ahead of the misses
+	config.background = true;
+	config.lowWater = batch;
+	evictionMgr.configureEviction(config);
+	for (i = 1; i <= frames; i++)
+	{
+		evictionMgr.readPage(file1ptr, i, page);
+		evictionMgr.unPinPage(file1ptr, i, true);
+	}
+	evictionMgr.clearBufStats();
+	for (int wait = 0; wait < 5000 && evictionMgr.getBufStats().diskwrites < (int)batch; wait++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	evictionMgr.configureEviction(EvictionConfig());
+	evictionMgr.clearBufStats();
+	evictionMgr.readPage(file1ptr, frames + 1, page);
+	evictionMgr.unPinPage(file1ptr, frames + 1, false);
+	if(evictionMgr.getBufStats().diskwrites != 0)
+	{
+		PRINT_ERROR("ERROR :: Background evictor did not free any frames.");
+	}
+
+	//A pool with every frame pinned is still reported full
+	for (i = 1; i <= frames; i++)
+	{
+		evictionMgr.readPage(file1ptr, i, page);
+	}
+	try
+	{
+		evictionMgr.readPage(file1ptr, frames + 1, page);
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException&)
+	{
+	}
+	for (i = 1; i <= frames; i++)
+	{
+		evictionMgr.unPinPage(file1ptr, i, false);
+	}
+
+	std::cout << "Test 15 passed" << "\n";
+}
+
+void test16()
+{
+	//Flushing one file leaves the pages of other files alone, and dropping a
+	//file throws its changes away instead of writing them out
+	const PageId dropPages = 3;
+	const PageId flushPages = 4;
+	BufMgr fileMgr(20);
+	RecordId dropRid[dropPages];
+	for (i = 0; i < dropPages; i++)
+	{
+		fileMgr.readPage(file1ptr, i + 1, page);
+		dropRid[i] = page->insertRecord("dropped");
+		fileMgr.unPinPage(file1ptr, i + 1, true);
+	}
+	for (i = 0; i < flushPages; i++)
+	{
+		fileMgr.readPage(file2ptr, i + 1, page);
+		fileMgr.unPinPage(file2ptr, i + 1, true);
+	}
+
+	fileMgr.clearBufStats();
+	fileMgr.flushFile(file2ptr);
+	if(fileMgr.getBufStats().diskwrites != (int)flushPages)
+	{
+		PRINT_ERROR("ERROR :: flushFile wrote pages of other files.");
+	}
+	for (i = 1; i <= dropPages; i++)
+	{
+		fileMgr.readPage(file1ptr, i, page);
+		fileMgr.unPinPage(file1ptr, i, false);
+	}
+	if(fileMgr.getBufStats().diskreads != 0)
+	{
+		PRINT_ERROR("ERROR :: flushFile evicted pages of other files.");
+	}
+
+	fileMgr.dropFile(file1ptr);
+	if(fileMgr.getBufStats().diskwrites != (int)flushPages)
+	{
+		PRINT_ERROR("ERROR :: dropFile wrote dropped pages.");
+	}
+	for (i = 0; i < dropPages; i++)
+	{
+		fileMgr.readPage(file1ptr, i + 1, page);
+		try
+		{
+			page->getRecord(dropRid[i]);
+			PRINT_ERROR("ERROR :: Record of a dropped page was written out. Exception should have been thrown before execution reaches this point.");
+		}
+		catch(const InvalidRecordException&)
+		{
+		}
+		fileMgr.unPinPage(file1ptr, i + 1, false);
+	}
+	if(fileMgr.getBufStats().diskreads != (int)dropPages)
+	{
+		PRINT_ERROR("ERROR :: dropFile left pages in the pool.");
+	}
+	fileMgr.flushFile(file1ptr);
+
+	//A page read through two File objects of one file sits in two frames,
+	//and flushFile() and the destructor write back both
+	const std::string& twinName = "test.7";
+	PageId twinPid;
+	{
+		File twin = File::create(twinName);
+		twinPid = twin.allocatePage().page_number();
+	}
+	{
+		File first = File::open(twinName);
+		File second = File::open(twinName);
+		RecordId firstRid;
+		RecordId secondRid;
+		{
+			BufMgr twinMgr(4);
+			twinMgr.readPage(&first, twinPid, page);
+			firstRid = page->insertRecord("first");
+			twinMgr.unPinPage(&first, twinPid, true);
+			twinMgr.readPage(&second, twinPid, page);
+			twinMgr.unPinPage(&second, twinPid, false);
+		}
+		if(first.readPage(twinPid).getRecord(firstRid) != "first")
+		{
+			PRINT_ERROR("ERROR :: Dirty page was not written back on shutdown.");
+		}
+		BufMgr twinMgr(4);
+		twinMgr.readPage(&first, twinPid, page);
+		twinMgr.unPinPage(&first, twinPid, false);
+		twinMgr.readPage(&second, twinPid, page);
+		secondRid = page->insertRecord("second");
+		twinMgr.unPinPage(&second, twinPid, true);
+		twinMgr.flushFile(&first);
+		if(first.readPage(twinPid).getRecord(secondRid) != "second")
+		{
+			PRINT_ERROR("ERROR :: flushFile missed a page read through another File object.");
+		}
+	}
+	File::remove(twinName);
+
+	std::cout << "Test 16 passed" << "\n";
+}
+
+void test17()
+{
+	//Dirty pages are written back in page order, adjacent ones in one run
+	const PageId flushPages = 12;
+	BufMgr flushMgr(20);
+	PageId flushPid[flushPages];
+	for (i = 0; i < flushPages; i++)
+	{
+		flushMgr.allocPage(file4ptr, flushPid[i], page);
+		sprintf(tmpbuf, "flush.4 Page %d %7.1f", flushPid[i], (float)flushPid[i]);
+		page->insertRecord(tmpbuf);
+		flushMgr.unPinPage(file4ptr, flushPid[i], true);
+	}
+	flushMgr.clearBufStats();
+	flushMgr.flushFile(file4ptr);
+	if(flushMgr.getBufStats().diskwrites != (int)flushPages)
+	{
+		PRINT_ERROR("ERROR :: flushFile did not write every dirty page.");
+	}
+	for (i = 0; i < flushPages; i++)
+	{
+		flushMgr.readPage(file4ptr, flushPid[i], page);
+		sprintf(tmpbuf, "flush.4 Page %d %7.1f", flushPid[i], (float)flushPid[i]);
+		rid2.page_number = flushPid[i];
+		rid2.slot_number = 1;
+		if(strncmp(page->getRecord(rid2).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		flushMgr.unPinPage(file4ptr, flushPid[i], false);
+	}
+	flushMgr.flushFile(file4ptr);
+
+	//Out of order pages with one gap make two runs
+	std::vector<Page> pages;
+	for (i = flushPages; i > 0; i--)
+	{
+		if(i != flushPages / 2)
+		{
+			pages.push_back(file4ptr->readPage(flushPid[i - 1]));
+		}
+	}
+	std::vector<const Page*> pagePtrs;
+	for (std::size_t j = 0; j < pages.size(); j++)
+	{
+		pagePtrs.push_back(&pages[j]);
+	}
+	if(file4ptr->writePages(pagePtrs) != 2)
+	{
+		PRINT_ERROR("ERROR :: Adjacent pages were not written in runs.");
+	}
+
+	//Nothing is written if any of the pages is gone
+	pages[0].insertRecord("unwritten");
+	file4ptr->deletePage(pages.back().page_number());
+	try
+	{
+		file4ptr->writePages(pagePtrs);
+		PRINT_ERROR("ERROR :: Page was deleted. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const InvalidPageException&)
+	{
+	}
+	RecordId unwrittenRid = {pages[0].page_number(), 2};
+	try
+	{
+		file4ptr->readPage(pages[0].page_number()).getRecord(unwrittenRid);
+		PRINT_ERROR("ERROR :: Pages were written although one was deleted. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const InvalidRecordException&)
+	{
+	}
+
+	std::cout << "Test 17 passed" << "\n";
+}
+
+void test18()
+{
+	//Reads are positional, so threads read one file at once without a latch,
+	//each through its own File object sharing the descriptor
+	std::atomic<int> mismatches(0);
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; t++)
+	{
+		readers.push_back(std::thread([&mismatches, t]()
+		{
+			File reader = File::open(file1ptr->filename());
+			char buf[100];
+			for (PageId k = 0; k < 2 * num; k++)
+			{
+				PageId pageNo = (k * (t + 1)) % num + 1;
+				Page p = reader.readPage(pageNo);
+				sprintf(buf, "test.1 Page %d %7.1f", pageNo, (float)pageNo);
+				RecordId recordId = {pageNo, 1};
+				if(strncmp(p.getRecord(recordId).c_str(), buf, strlen(buf)) != 0)
+				{
+					mismatches++;
+				}
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < readers.size(); t++)
+		readers[t].join();
+	if(mismatches != 0)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+
+	//A file stays open while any File object refers to it
+	const std::string& filename = "test.6";
+	{
+		File created = File::create(filename);
+		{
+			File copy = created;
+			File reopened = File::open(filename);
+		}
+		if(!File::isOpen(filename))
+		{
+			PRINT_ERROR("ERROR :: File was closed while still referred to.");
+		}
+	}
+	if(File::isOpen(filename))
+	{
+		PRINT_ERROR("ERROR :: File was not closed with its last File object.");
+	}
+	File::remove(filename);
+
+	std::cout << "Test 18 passed" << "\n";
+}
+
+void test19()
+{
+	//Many reads in flight at once from one thread, completing on the I/O thread
+	const std::uint32_t frames = 30;
+	const PageId asyncPages = 20;
+	BufMgr asyncMgr(frames);
+	asyncMgr.enableAsyncIo(8);
+	std::atomic<int> completed(0);
+	std::atomic<int> mismatches(0);
+	for (i = 1; i <= asyncPages; i++)
+	{
+		PageId pageNo = i;
+		asyncMgr.readPageAsync(file1ptr, pageNo, [&completed, &mismatches, pageNo](const BufStatus status, Page* p)
+		{
+			char buf[100];
+			sprintf(buf, "test.1 Page %d %7.1f", pageNo, (float)pageNo);
+			RecordId recordId = {pageNo, 1};
+			if(status != BufStatus::OK || strncmp(p->getRecord(recordId).c_str(), buf, strlen(buf)) != 0)
+			{
+				mismatches++;
+			}
+			completed++;
+		});
+	}
+	//A second read of a page already on its way waits for the first one
+	std::future<Page*> again = asyncMgr.readPageAsync(file1ptr, 1);
+	asyncMgr.submitIo();
+	if(again.get()->page_number() != 1)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+	for (int wait = 0; wait < 5000 && completed < (int)asyncPages; wait++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if(completed != (int)asyncPages || mismatches != 0)
+	{
+		PRINT_ERROR("ERROR :: Asynchronous reads did not complete with the right pages.");
+	}
+	if(asyncMgr.getBufStats().diskreads != (int)asyncPages)
+	{
+		PRINT_ERROR("ERROR :: A page was read more than once.");
+	}
+	asyncMgr.unPinPage(file1ptr, 1, false);
+	for (i = 1; i <= asyncPages; i++)
+	{
+		asyncMgr.unPinPage(file1ptr, i, false);
+	}
+
+	//A synchronous read of a page still queued submits it rather than waiting forever
+	std::future<Page*> queued = asyncMgr.readPageAsync(file1ptr, asyncPages + 1);
+	asyncMgr.readPage(file1ptr, asyncPages + 1, page);
+	if(queued.get() != page)
+	{
+		PRINT_ERROR("ERROR :: Both reads should have pinned the same frame.");
+	}
+	asyncMgr.unPinPage(file1ptr, asyncPages + 1, false);
+	asyncMgr.unPinPage(file1ptr, asyncPages + 1, false);
+
+	//Failed reads come back as exceptions from the future
+	std::future<Page*> missing = asyncMgr.readPageAsync(file4ptr, 1000);
+	asyncMgr.submitIo();
+	try
+	{
+		missing.get();
+		PRINT_ERROR("ERROR :: Page 1000 of file4 was never allocated. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const InvalidPageException&)
+	{
+	}
+	for (i = 1; i <= frames; i++)
+	{
+		asyncMgr.readPage(file1ptr, i, page);
+	}
+	try
+	{
+		asyncMgr.readPageAsync(file1ptr, frames + 1).get();
+		PRINT_ERROR("ERROR :: No more frames left for allocation. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException&)
+	{
+	}
+	for (i = 1; i <= frames; i++)
+	{
+		asyncMgr.unPinPage(file1ptr, i, false);
+	}
+
+	//Disposing of a page still being read waits for the read to land first
+	PageId disposedPageNo;
+	asyncMgr.allocPage(file4ptr, disposedPageNo, page);
+	asyncMgr.unPinPage(file4ptr, disposedPageNo, true);
+	asyncMgr.flushFile(file4ptr);
+	std::future<Page*> disposed = asyncMgr.readPageAsync(file4ptr, disposedPageNo);
+	asyncMgr.disposePage(file4ptr, disposedPageNo);
+	if(disposed.get()->page_number() != disposedPageNo
+		|| asyncMgr.tryUnpin(file4ptr, disposedPageNo, false) != BufStatus::NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: Disposed page should have left the pool after its read.");
+	}
+
+	//A failed write-back of a dirty page of a read-only file reaches the callback, not the caller, whether
+	//the read is asynchronous or not
+	const std::string& filename = "test.6";
+	PageId pageNos[2];
+	{
+		File created = File::create(filename);
+		for (int k = 0; k < 2; k++)
+		{
+			Page added = created.allocatePage();
+			pageNos[k] = added.page_number();
+			created.writePage(added);
+		}
+	}
+	for (int async = 0; async < 2; async++)
+	{
+		File readOnly = File::openMapped(filename);
+		BufMgr failingMgr(1);
+		if(async)
+		{
+			failingMgr.enableAsyncIo(8);
+		}
+		failingMgr.readPage(&readOnly, pageNos[0], page);
+		failingMgr.unPinPage(&readOnly, pageNos[0], true);
+		BufStatus reported = BufStatus::OK;
+		failingMgr.readPageAsync(&readOnly, pageNos[1], [&reported](const BufStatus status, Page*)
+		{
+			reported = status;
+		});
+		if(reported != BufStatus::IO_ERROR)
+		{
+			PRINT_ERROR("ERROR :: Writing back to a read-only file failed, the callback should have been told.");
+		}
+		failingMgr.dropFile(&readOnly);
+	}
+	File::remove(filename);
+
+	std::cout << "Test 19 passed" << "\n";
+}
+
+void test20()
+{
+	//Pages of a direct file bypass the page cache on their way in and out
+	const std::string& filename = "test.6";
+	const PageId directPages = 10;
+	{
+		File direct = File::create(filename, true);
+		if(!direct.isDirect())
+		{
+			std::cout << "Direct I/O is not supported here, test 20 runs buffered" << "\n";
+		}
+		for (i = 0; i < directPages; i++)
+		{
+			bufMgr->allocPage(&direct, pid[i], page);
+			sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[i], (float)pid[i]);
+			rid[i] = page->insertRecord(tmpbuf);
+			bufMgr->unPinPage(&direct, pid[i], true);
+		}
+		bufMgr->flushFile(&direct);
+		for (i = 0; i < directPages; i++)
+		{
+			bufMgr->readPage(&direct, pid[i], page);
+			sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[i], (float)pid[i]);
+			if(strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+			}
+			bufMgr->unPinPage(&direct, pid[i], false);
+		}
+		bufMgr->flushFile(&direct);
+	}
+
+	//The layout is the same either way, so the file reads back buffered
+	{
+		File buffered = File::open(filename);
+		for (i = 0; i < directPages; i++)
+		{
+			Page p = buffered.readPage(pid[i]);
+			sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[i], (float)pid[i]);
+			if(strncmp(p.getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+			}
+		}
+	}
+	File::remove(filename);
+
+	//A buffered file keeps the old layout, which is never opened direct
+	{
+		File::create(filename);
+		File buffered = File::open(filename, true);
+		if(buffered.isDirect())
+		{
+			PRINT_ERROR("ERROR :: File in the old layout opened for direct I/O.");
+		}
+
+		//Writing a copy read before the page was relinked keeps the new link
+		Page tail = buffered.allocatePage();
+		Page stale = buffered.readPage(tail.page_number());
+		Page appended = buffered.allocatePage();
+		buffered.writePage(stale);
+		PageId listed = 0;
+		for (FileIterator iter = buffered.begin(); iter != buffered.end(); ++iter)
+		{
+			listed++;
+		}
+		if(listed != 2)
+		{
+			PRINT_ERROR("ERROR :: Stale page write dropped a page from the used list.");
+		}
+
+		//A page deleted since it was read is not written back
+		buffered.deletePage(appended.page_number());
+		try
+		{
+			buffered.writePage(appended);
+			PRINT_ERROR("ERROR :: Deleted page was written.");
+		}
+		catch(const InvalidPageException&)
+		{
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 20 passed" << "\n";
+}
+
+void test21()
+{
+	//A mapped file reads like any other but refuses writes
+	const std::string& filename = "test.6";
+	const PageId mappedPages = 10;
+	{
+		File written = File::create(filename);
+		for (i = 0; i < mappedPages; i++)
+		{
+			Page p = written.allocatePage();
+			pid[i] = p.page_number();
+			sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[i], (float)pid[i]);
+			rid[i] = p.insertRecord(tmpbuf);
+			written.writePage(p);
+		}
+	}
+	{
+		File mapped = File::openMapped(filename, File::Advice::SEQUENTIAL);
+		if(!mapped.isMapped())
+		{
+			PRINT_ERROR("ERROR :: File should have been mapped.");
+		}
+		mapped.advise(File::Advice::WILL_NEED, pid[0], mappedPages);
+		for (i = 0; i < mappedPages; i++)
+		{
+			bufMgr->readPage(&mapped, pid[i], page);
+			sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[i], (float)pid[i]);
+			if(strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+			}
+			bufMgr->unPinPage(&mapped, pid[i], false);
+		}
+		bufMgr->dropFile(&mapped);
+
+		//Pages can be read in place, without a copy
+		for (i = 0; i < mappedPages; i++)
+		{
+			const Page* inPlace = mapped.mappedPage(pid[i]);
+			sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[i], (float)pid[i]);
+			if(inPlace == NULL || strncmp(inPlace->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+			}
+		}
+
+		Page first = mapped.readPage(pid[0]);
+		try
+		{
+			mapped.writePage(first);
+			PRINT_ERROR("ERROR :: Mapped file was written. Exception should have been thrown before execution reaches this point.");
+		}
+		catch(const ReadOnlyFileException&)
+		{
+		}
+		try
+		{
+			mapped.allocatePage();
+			PRINT_ERROR("ERROR :: Mapped file was written. Exception should have been thrown before execution reaches this point.");
+		}
+		catch(const ReadOnlyFileException&)
+		{
+		}
+
+		//Pages added after the file was mapped are read past the mapping
+		File writer = File::open(filename);
+		Page added = writer.allocatePage();
+		added.insertRecord("past the mapping");
+		writer.writePage(added);
+		RecordId addedRid = {added.page_number(), 1};
+		if(mapped.readPage(added.page_number()).getRecord(addedRid) != "past the mapping")
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		if(mapped.mappedPage(added.page_number()) != NULL)
+		{
+			PRINT_ERROR("ERROR :: Page past the mapping was handed out in place.");
+		}
+	}
+	//Files the caller may not write can still be mapped
+	chmod(filename.c_str(), 0444);
+	{
+		File mapped = File::openMapped(filename);
+		Page first = mapped.readPage(pid[0]);
+		sprintf((char*)tmpbuf, "test.6 Page %d %7.1f", pid[0], (float)pid[0]);
+		if(strncmp(first.getRecord(rid[0]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+	chmod(filename.c_str(), 0644);
+	File::remove(filename);
+
+	std::cout << "Test 21 passed" << "\n";
+}
+
+void test22()
+{
+	//Pages read or allocated into an existing page replace all of its contents
+	Page target = file1ptr->readPage(1);
+	file1ptr->readPage(2, &target);
+	sprintf((char*)tmpbuf, "test.1 Page %d %7.1f", 2, (float)2);
+	RecordId recordId = {2, 1};
+	if(target.page_number() != 2 || strncmp(target.getRecord(recordId).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+	try
+	{
+		file1ptr->readPage(100000, &target);
+		PRINT_ERROR("ERROR :: Page 100000 of file1 was never allocated. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const InvalidPageException&)
+	{
+	}
+
+	const std::string& filename = "test.6";
+	{
+		File fresh = File::create(filename);
+		fresh.allocatePage(&target);
+		if(target.begin() != target.end())
+		{
+			PRINT_ERROR("ERROR :: A newly allocated page should hold no records.");
+		}
+		if(fresh.readPage(target.page_number()).page_number() != target.page_number())
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 22 passed" << "\n";
+}
+
+void test23()
+{
+	//Frames are fixed-stride slices of one aligned arena of whole huge pages
+	if((std::uintptr_t)bufMgr->bufPool % BufMgr::ARENA_ALIGNMENT != 0 || bufMgr->arenaSize() % BufMgr::ARENA_ALIGNMENT != 0
+		|| bufMgr->arenaSize() < num * sizeof(Page))
+	{
+		PRINT_ERROR("ERROR :: Buffer pool is not laid out in an aligned arena.");
+	}
+	for (i = 0; i < num; i++)
+	{
+		bufMgr->readPage(file1ptr, i + 1, page);
+		if((char*)page < (char*)bufMgr->bufPool || ((char*)page - (char*)bufMgr->bufPool) % sizeof(Page) != 0
+			|| (char*)page + sizeof(Page) > (char*)bufMgr->bufPool + bufMgr->arenaSize())
+		{
+			PRINT_ERROR("ERROR :: Frame lies outside the arena.");
+		}
+	}
+	for (i = 0; i < num; i++)
+	{
+		bufMgr->unPinPage(file1ptr, i + 1, false);
+	}
+
+	std::cout << "Test 23 passed" << "\n";
+}
+
+/**
+ * Returns the number of memory pages of the range that are resident.
+ */
+std::size_t residentPages(void* start, const std::size_t length)
+{
+	const std::size_t memoryPage = sysconf(_SC_PAGESIZE);
+	std::vector<unsigned char> resident((length + memoryPage - 1) / memoryPage);
+	if(mincore(start, length, &resident[0]) != 0)
+	{
+		return 0;
+	}
+	std::size_t count = 0;
+	for (std::size_t k = 0; k < resident.size(); k++)
+	{
+		count += resident[k] & 1;
+	}
+	return count;
+}
+
+void test24()
+{
+	//A new pool touches none of its frames; they fault in as they are used or prefaulted
+	const std::uint32_t frames = 512;
+	BufMgr lazyMgr(frames);
+	if(residentPages(lazyMgr.bufPool, lazyMgr.arenaSize()) != 0)
+	{
+		PRINT_ERROR("ERROR :: Frames were touched before their first use.");
+	}
+	lazyMgr.readPage(file1ptr, 1, page);
+	if(residentPages(lazyMgr.bufPool, lazyMgr.arenaSize()) == 0)
+	{
+		PRINT_ERROR("ERROR :: Frame in use is not resident.");
+	}
+	sprintf((char*)tmpbuf, "test.1 Page %d %7.1f", 1, (float)1);
+	RecordId recordId = {1, 1};
+	if(strncmp(page->getRecord(recordId).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+	{
+		PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+	}
+	lazyMgr.prefaultPool(false);
+	const std::size_t memoryPage = sysconf(_SC_PAGESIZE);
+	std::size_t resident = residentPages(lazyMgr.bufPool, lazyMgr.arenaSize());
+	//Kernels without MADV_POPULATE_WRITE leave the pool as it was
+	bool populates = madvise(lazyMgr.bufPool, memoryPage, MADV_POPULATE_WRITE) == 0;
+	if(populates && resident != lazyMgr.arenaSize() / memoryPage)
+	{
+		PRINT_ERROR("ERROR :: Pool was only partly prefaulted.");
+	}
+	if(strncmp(page->getRecord(recordId).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+	{
+		PRINT_ERROR("ERROR :: Prefaulting changed a frame in use.");
+	}
+	lazyMgr.unPinPage(file1ptr, 1, false);
+
+	//A background prefault is stopped by the destructor
+	{
+		BufMgr backgroundMgr(frames);
+		backgroundMgr.prefaultPool();
+	}
+
+	//Frames are handed out from frame 0 up, and released frames are reused
+	//before any frame never used
+	{
+		BufMgr orderMgr(frames);
+		for (i = 1; i <= 3; i++)
+		{
+			orderMgr.readPage(file1ptr, i, page);
+			if(page != &orderMgr.bufPool[i - 1])
+			{
+				PRINT_ERROR("ERROR :: Frames were not handed out in order.");
+			}
+		}
+		for (i = 1; i <= 3; i++)
+			orderMgr.unPinPage(file1ptr, i, false);
+		orderMgr.flushFile(file1ptr);
+		orderMgr.readPage(file1ptr, 4, page);
+		if(page >= &orderMgr.bufPool[3])
+		{
+			PRINT_ERROR("ERROR :: Released frame was not reused first.");
+		}
+		orderMgr.unPinPage(file1ptr, 4, false);
+	}
+
+	std::cout << "Test 24 passed" << "\n";
+}
+
+void test25()
+{
+	//Pins, unpins and dirty marks of many threads on one frame all land in its state word
+	bufMgr->flushFile(file1ptr);
+	bufMgr->clearBufStats();
+	std::vector<std::thread> pinners;
+	for (int t = 0; t < 4; t++)
+	{
+		pinners.push_back(std::thread([t]()
+		{
+			Page* p;
+			for (int k = 0; k < 1000; k++)
+			{
+				bufMgr->readPage(file1ptr, 1, p);
+				bufMgr->unPinPage(file1ptr, 1, t == 0 && k == 500);
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < pinners.size(); t++)
+		pinners[t].join();
+	try
+	{
+		bufMgr->unPinPage(file1ptr, 1, false);
+		PRINT_ERROR("ERROR :: Page is already unpinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PageNotPinnedException&)
+	{
+	}
+	bufMgr->flushFile(file1ptr);
+	if(bufMgr->getBufStats().diskwrites != 1)
+	{
+		PRINT_ERROR("ERROR :: The page marked dirty should have been written back exactly once.");
+	}
+
+	std::cout << "Test 25 passed" << "\n";
+}
+
+void test26()
+{
+	//Pages pinned over and over keep their usage counts through a scan as
+	//long as the pool under GCLOCK, while single-bit CLOCK treats them like
+	//the scanned pages and gives some of them up
+	const std::uint32_t frames = 10;
+	const PageId hotPages = 5;
+	std::uint32_t rereads[2];
+	for (int gclock = 0; gclock < 2; gclock++)
+	{
+		BufMgr clockMgr(frames, 1, new ClockPolicy(frames, gclock ? 5 : 1));
+		for (int round = 0; round < 5; round++)
+		{
+			for (i = 1; i <= hotPages; i++)
+			{
+				clockMgr.readPage(file1ptr, i, page);
+				clockMgr.unPinPage(file1ptr, i, false);
+			}
+		}
+		for (i = hotPages + 1; i <= hotPages + frames; i++)
+		{
+			clockMgr.readPage(file1ptr, i, page);
+			clockMgr.unPinPage(file1ptr, i, false);
+		}
+
+		clockMgr.clearBufStats();
+		for (i = 1; i <= hotPages; i++)
+		{
+			clockMgr.readPage(file1ptr, i, page);
+			clockMgr.unPinPage(file1ptr, i, false);
+		}
+		rereads[gclock] = clockMgr.getBufStats().diskreads;
+	}
+	if(rereads[1] != 0)
+	{
+		PRINT_ERROR("ERROR :: Scan evicted pages with a higher usage count.");
+	}
+	if(rereads[0] == 0)
+	{
+		PRINT_ERROR("ERROR :: Single-bit CLOCK should not tell the pages apart.");
+	}
+
+	std::cout << "Test 26 passed" << "\n";
+}
+
+void test27()
+{
+	//With every frame pinned, a miss waits for an unpin instead of failing,
+	//up to the configured timeout
+	const std::uint32_t frames = 3;
+	BufMgr waitMgr(frames, 1);
+	EvictionConfig config;
+	config.allocTimeoutMs = 50;
+	waitMgr.configureEviction(config);
+	for (i = 1; i <= frames; i++)
+	{
+		waitMgr.readPage(file1ptr, i, page);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	try
+	{
+		waitMgr.readPage(file1ptr, frames + 1, page);
+		PRINT_ERROR("ERROR :: No frame was unpinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException&)
+	{
+	}
+	if(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(config.allocTimeoutMs))
+	{
+		PRINT_ERROR("ERROR :: Allocation gave up before its timeout.");
+	}
+
+	//An unpin from another thread hands its frame to the waiting miss
+	config.allocTimeoutMs = 10000;
+	waitMgr.configureEviction(config);
+	std::thread unpinner([&waitMgr]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		waitMgr.unPinPage(file1ptr, 1, false);
+	});
+	start = std::chrono::steady_clock::now();
+	waitMgr.readPage(file1ptr, frames + 1, page);
+	if(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(config.allocTimeoutMs))
+	{
+		PRINT_ERROR("ERROR :: Allocation was not woken up by the unpin.");
+	}
+	unpinner.join();
+	for (i = 2; i <= frames + 1; i++)
+	{
+		waitMgr.unPinPage(file1ptr, i, false);
+	}
+
+	std::cout << "Test 27 passed" << "\n";
+}
+
+void test28()
+{
+	//A batch pins hits and misses alike, reads each missing page once, and
+	//pins a page listed twice twice
+	const std::uint32_t frames = 20;
+	BufMgr batchMgr(frames, 4);
+	batchMgr.readPage(file1ptr, 3, page);
+	batchMgr.unPinPage(file1ptr, 3, false);
+	batchMgr.clearBufStats();
+
+	std::vector<PageId> pageNos = {7, 3, 5, 6, 4, 7};
+	std::vector<Page*> pages;
+	batchMgr.readPages(file1ptr, pageNos, pages);
+	if(pages.size() != pageNos.size())
+	{
+		PRINT_ERROR("ERROR :: Every page of the batch should be returned.");
+	}
+	for (std::size_t k = 0; k < pageNos.size(); k++)
+	{
+		if(pages[k]->page_number() != pageNos[k])
+		{
+			PRINT_ERROR("ERROR :: Batch returned the wrong page.");
+		}
+	}
+	if(pages[0] != pages[5] || batchMgr.getBufStats().diskreads != 4 || batchMgr.getBufStats().accesses != 6)
+	{
+		PRINT_ERROR("ERROR :: Batch should read each missing page exactly once.");
+	}
+	batchMgr.unPinPages(file1ptr, pageNos, false);
+	try
+	{
+		batchMgr.unPinPage(file1ptr, 7, false);
+		PRINT_ERROR("ERROR :: Page is already unpinned. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const PageNotPinnedException&)
+	{
+	}
+
+	//Adjacent pages are read together
+	std::vector<Page> copies(4);
+	std::vector<Page*> into = {&copies[0], &copies[1], &copies[2], &copies[3]};
+	if(file1ptr->readPages(std::vector<PageId>{10, 8, 9, 12}, into) != 2 || copies[1].page_number() != 8)
+	{
+		PRINT_ERROR("ERROR :: Runs of adjacent pages should be read with one call each.");
+	}
+
+	//A failing batch leaves nothing pinned
+	try
+	{
+		batchMgr.readPages(file1ptr, std::vector<PageId>{1, 2, 100000}, pages);
+		PRINT_ERROR("ERROR :: Page does not exist. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const InvalidPageException&)
+	{
+	}
+	std::vector<PageId> tooMany;
+	for (PageId pageNo = 1; pageNo <= frames + 1; pageNo++)
+	{
+		tooMany.push_back(pageNo);
+	}
+	try
+	{
+		batchMgr.readPages(file1ptr, tooMany, pages);
+		PRINT_ERROR("ERROR :: Batch exceeds the pool. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const BufferExceededException&)
+	{
+	}
+	tooMany.pop_back();
+	batchMgr.readPages(file1ptr, tooMany, pages);
+	batchMgr.unPinPages(file1ptr, tooMany, false);
+
+	std::cout << "Test 28 passed" << "\n";
+}
+
+void test29()
+{
+	//A sequential scan only misses on its first two pages, read-ahead brings
+	//in the rest; flushFile() waits for reads still in flight
+	BufMgr aheadMgr(64, 4);
+	ReadAheadConfig config;
+	config.initialPages = 4;
+	config.maxPages = 16;
+	aheadMgr.enableReadAhead(config);
+	for (i = 20; i <= 60; i++)
+	{
+		aheadMgr.readPage(file1ptr, i, page);
+		if(page->page_number() != (PageId)i)
+		{
+			PRINT_ERROR("ERROR :: Read-ahead returned the wrong page.");
+		}
+		aheadMgr.unPinPage(file1ptr, i, false);
+	}
+	aheadMgr.flushFile(file1ptr);
+	if(aheadMgr.getBufStats().readaheads == 0
+		|| aheadMgr.getBufStats().diskreads - aheadMgr.getBufStats().readaheads != 2)
+	{
+		PRINT_ERROR("ERROR :: Sequential scan should have been read ahead after two misses.");
+	}
+
+	//Strided runs are read ahead after three reads, random reads never are
+	aheadMgr.clearBufStats();
+	for (i = 10; i <= 30; i += 3)
+	{
+		aheadMgr.readPage(file1ptr, i, page);
+		aheadMgr.unPinPage(file1ptr, i, false);
+	}
+	aheadMgr.flushFile(file1ptr);
+	if(aheadMgr.getBufStats().diskreads - aheadMgr.getBufStats().readaheads != 3)
+	{
+		PRINT_ERROR("ERROR :: Strided scan should have been read ahead after three misses.");
+	}
+	aheadMgr.clearBufStats();
+	const PageId scattered[] = {50, 5, 77, 31, 64, 12};
+	for (std::size_t k = 0; k < sizeof(scattered) / sizeof(scattered[0]); k++)
+	{
+		aheadMgr.readPage(file1ptr, scattered[k], page);
+		aheadMgr.unPinPage(file1ptr, scattered[k], false);
+	}
+	aheadMgr.flushFile(file1ptr);
+	if(aheadMgr.getBufStats().readaheads != 0)
+	{
+		PRINT_ERROR("ERROR :: Random reads should not be read ahead.");
+	}
+
+	//A scan through pages already in the pool keeps its run going
+	BufMgr passMgr(64, 4);
+	passMgr.enableReadAhead(config);
+	const PageId preloaded[] = {71, 68, 74, 70, 75, 69, 73, 72};
+	for (std::size_t k = 0; k < sizeof(preloaded) / sizeof(preloaded[0]); k++)
+	{
+		passMgr.readPage(file1ptr, preloaded[k], page);
+		passMgr.unPinPage(file1ptr, preloaded[k], false);
+	}
+	passMgr.clearBufStats();
+	for (i = 66; i <= 90; i++)
+	{
+		passMgr.readPage(file1ptr, i, page);
+		passMgr.unPinPage(file1ptr, i, false);
+	}
+	passMgr.flushFile(file1ptr);
+	if(passMgr.getBufStats().diskreads - passMgr.getBufStats().readaheads != 2)
+	{
+		PRINT_ERROR("ERROR :: Resident pages broke the run of a sequential scan.");
+	}
+
+	//A full pool is read ahead into by evicting cold pages, as a miss would
+	BufMgr fullMgr(8);
+	fullMgr.enableReadAhead(config);
+	const PageId resident[] = {50, 5, 77, 31, 64, 12, 40, 90};
+	for (std::size_t k = 0; k < sizeof(resident) / sizeof(resident[0]); k++)
+	{
+		fullMgr.readPage(file1ptr, resident[k], page);
+		fullMgr.unPinPage(file1ptr, resident[k], false);
+	}
+	for (i = 20; i <= 23; i++)
+	{
+		fullMgr.readPage(file1ptr, i, page);
+		fullMgr.unPinPage(file1ptr, i, false);
+	}
+	fullMgr.flushFile(file1ptr);
+	if(fullMgr.getBufStats().readaheads == 0
+		|| fullMgr.getBufStats().diskreads - fullMgr.getBufStats().readaheads != 10)
+	{
+		PRINT_ERROR("ERROR :: Full pool should have been read ahead into after two misses.");
+	}
+
+	//Running into the end of the file leaves nothing behind
+	for (i = num - 5; i <= num; i++)
+	{
+		aheadMgr.readPage(file1ptr, i, page);
+		aheadMgr.unPinPage(file1ptr, i, false);
+	}
+	aheadMgr.flushFile(file1ptr);
+
+	std::cout << "Test 29 passed" << "\n";
+}
@@ -102,6 +102,10 @@ class PageIterator;
  * slots and identified by a RecordId.  Although a record's actual contents may
  * be moved on the page, accessing a record by its slot is consistent.
  *
+ * The header and data are stored inline, laid out exactly as on disk, so a
+ * Page is one contiguous block of SIZE bytes that is read and written with a
+ * single transfer and needs no allocation of its own.
+ *
  * @warning This class is not threadsafe.
  */
 class Page {
@@ -329,8 +333,7 @@ class Page {
    * Data stored on the page.  Includes bookkeeping information about slots as
    * well as actual content.
    */
-
-  std::string data_;
+  char data_[DATA_SIZE];
 
   friend class File;
   friend class PageIterator;
@@ -342,5 +345,7 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page must be laid out in memory exactly as on disk.");
 
 }
@@ -0,0 +1,54 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "pageGuard.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+PageGuard::PageGuard()
+	: bufMgr(NULL), frameNo(0), page(NULL), dirty(false) {
+}
+
+PageGuard::PageGuard(BufMgr* mgr, const FrameId frameNum, Page* pagePtr)
+	: bufMgr(mgr), frameNo(frameNum), page(pagePtr), dirty(false) {
+}
+
+PageGuard::PageGuard(PageGuard&& other)
+	: bufMgr(other.bufMgr), frameNo(other.frameNo), page(other.page), dirty(other.dirty) {
+	other.bufMgr = NULL;
+}
+
+PageGuard& PageGuard::operator=(PageGuard&& other)
+{
+	if(this != &other)
+	{
+		release();
+		bufMgr = other.bufMgr;
+		frameNo = other.frameNo;
+		page = other.page;
+		dirty = other.dirty;
+		other.bufMgr = NULL;
+	}
+	return *this;
+}
+
+PageGuard::~PageGuard()
+{
+	release();
+}
+
+void PageGuard::release()
+{
+	if(bufMgr)
+	{
+		bufMgr->unpinFrame(frameNo, dirty);
+		bufMgr = NULL;
+	}
+}
+
+}
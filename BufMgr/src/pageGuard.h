@@ -0,0 +1,171 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <utility>
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufMgr;
+
+/**
+* @brief Owns one pin on a buffer pool frame and drops it when destroyed.
+*
+* A guard remembers the frame its page was read into, so releasing it unpins that frame directly instead of
+* looking the page up in the hash table again. Guards can be moved but not copied; a moved-from guard is
+* empty and releases nothing.
+*/
+class PageGuard {
+ public:
+	/**
+   * Constructs an empty guard
+	 */
+  PageGuard();
+
+	/**
+   * Takes over the pin held by other, leaving other empty
+	 */
+  PageGuard(PageGuard&& other);
+
+	/**
+   * Releases the pin held by this guard, then takes over the pin held by other
+	 */
+  PageGuard& operator=(PageGuard&& other);
+
+	/**
+   * Releases the pin held by this guard
+	 */
+  ~PageGuard();
+
+	/**
+   * Unpins the page now, marking it dirty if it was written through the guard. The guard is empty afterwards.
+	 */
+  void release();
+
+	/**
+   * Returns true if the guard holds a pin
+	 */
+  bool isValid() const
+	{
+		return bufMgr != NULL;
+	}
+
+	/**
+   * Returns the number of the guarded page in its file
+	 */
+  PageId pageNo() const
+	{
+		return page->page_number();
+	}
+
+ protected:
+	/**
+   * Constructs a guard for a page the buffer manager already pinned in frame frameNum
+	 */
+  PageGuard(BufMgr* mgr, const FrameId frameNum, Page* pagePtr);
+
+	/**
+   * Buffer manager holding the pin, NULL for an empty guard
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Frame the page is pinned in
+	 */
+  FrameId frameNo;
+
+	/**
+   * The pinned page
+	 */
+  Page* page;
+
+	/**
+   * True if the page has to be marked dirty when it is unpinned
+	 */
+  bool dirty;
+
+ private:
+  PageGuard(const PageGuard&) = delete;
+  PageGuard& operator=(const PageGuard&) = delete;
+};
+
+/**
+* @brief Guard giving read-only access to a pinned page
+*/
+class ReadPageGuard : public PageGuard {
+ public:
+	/**
+   * Constructs an empty guard
+	 */
+  ReadPageGuard() {}
+
+	/**
+   * Takes over the pin held by other, leaving other empty
+	 */
+  ReadPageGuard(ReadPageGuard&& other)
+		: PageGuard(std::move(other)) {}
+
+	/**
+   * Releases the pin held by this guard, then takes over the pin held by other
+	 */
+  ReadPageGuard& operator=(ReadPageGuard&& other)
+	{
+		PageGuard::operator=(std::move(other));
+		return *this;
+	}
+
+  const Page* operator->() const { return page; }
+
+  const Page& operator*() const { return *page; }
+
+ private:
+  ReadPageGuard(BufMgr* mgr, const FrameId frameNum, Page* pagePtr)
+		: PageGuard(mgr, frameNum, pagePtr) {}
+
+  friend class BufMgr;
+};
+
+/**
+* @brief Guard giving write access to a pinned page. Any access through the guard marks the page dirty.
+*/
+class WritePageGuard : public PageGuard {
+ public:
+	/**
+   * Constructs an empty guard
+	 */
+  WritePageGuard() {}
+
+	/**
+   * Takes over the pin held by other, leaving other empty
+	 */
+  WritePageGuard(WritePageGuard&& other)
+		: PageGuard(std::move(other)) {}
+
+	/**
+   * Releases the pin held by this guard, then takes over the pin held by other
+	 */
+  WritePageGuard& operator=(WritePageGuard&& other)
+	{
+		PageGuard::operator=(std::move(other));
+		return *this;
+	}
+
+  Page* operator->() { dirty = true; return page; }
+
+  Page& operator*() { dirty = true; return *page; }
+
+ private:
+  WritePageGuard(BufMgr* mgr, const FrameId frameNum, Page* pagePtr)
+		: PageGuard(mgr, frameNum, pagePtr) {}
+
+  friend class BufMgr;
+};
+
+}
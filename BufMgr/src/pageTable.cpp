@@ -0,0 +1,160 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include <vector>
+#include "pageTable.h"
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+namespace badgerdb {
+
+/**
+ * Returns the number of groups needed to hold entries while staying at most 7/8 full.
+ */
+static std::uint32_t groupsFor(const std::uint32_t entries)
+{
+  std::uint64_t slots = ((std::uint64_t)entries * 8 + 6) / 7;
+  std::uint32_t groups = 1;
+  while ((std::uint64_t)groups * PageTableGroup::WIDTH < slots)
+    groups <<= 1;
+  return groups;
+}
+
+PageTable::PageTable(const std::uint32_t maxEntries)
+  : groups(NULL)
+{
+  allocate(groupsFor(maxEntries));
+}
+
+PageTable::~PageTable()
+{
+  delete [] groups;
+}
+
+void PageTable::allocate(const std::uint32_t count)
+{
+  numGroups = count;
+  numEntries = 0;
+  numDeleted = 0;
+  groups = new PageTableGroup[count];
+  for (std::uint32_t i = 0; i < count; i++)
+    std::memset(groups[i].ctrl, CTRL_EMPTY, PageTableGroup::WIDTH);
+}
+
+void PageTable::insertUnique(const std::uint64_t key, const std::uint64_t hash, const FrameId frameNo)
+{
+  const std::uint32_t groupMask = numGroups - 1;
+  std::uint32_t index = (hash >> 7) & groupMask;
+  for (std::uint32_t step = 1; ; step++) {
+    PageTableGroup& group = groups[index];
+    const std::uint32_t free = matchFree(group);
+    if (free) {
+      const std::uint32_t i = __builtin_ctz(free);
+      if (group.ctrl[i] == CTRL_DELETED)
+        numDeleted--;
+      group.ctrl[i] = hash & 0x7F;
+      group.slots[i].key = key;
+      group.slots[i].frameNo = frameNo;
+      numEntries++;
+      return;
+    }
+    index = (index + step) & groupMask;
+  }
+}
+
+void PageTable::rehash(const std::uint32_t minEntries)
+{
+  // Deleted slots alone never shrink the table; it is cleared and refilled in
+  // its own storage.
+  if (groupsFor(minEntries) <= numGroups) {
+    std::vector<PageTableSlot> live;
+    live.reserve(numEntries);
+    for (std::uint32_t g = 0; g < numGroups; g++) {
+      for (std::uint32_t i = 0; i < PageTableGroup::WIDTH; i++) {
+        if (groups[g].ctrl[i] >= 0)
+          live.push_back(groups[g].slots[i]);
+      }
+      std::memset(groups[g].ctrl, CTRL_EMPTY, PageTableGroup::WIDTH);
+    }
+    numEntries = 0;
+    numDeleted = 0;
+    for (std::size_t i = 0; i < live.size(); i++)
+      insertUnique(live[i].key, mix(live[i].key), live[i].frameNo);
+    return;
+  }
+
+  PageTableGroup* oldGroups = groups;
+  const std::uint32_t oldNumGroups = numGroups;
+
+  allocate(groupsFor(minEntries));
+  for (std::uint32_t g = 0; g < oldNumGroups; g++) {
+    for (std::uint32_t i = 0; i < PageTableGroup::WIDTH; i++) {
+      if (oldGroups[g].ctrl[i] >= 0) {
+        const PageTableSlot& slot = oldGroups[g].slots[i];
+        insertUnique(slot.key, mix(slot.key), slot.frameNo);
+      }
+    }
+  }
+
+  delete [] oldGroups;
+}
+
+void PageTable::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  const std::uint64_t key = packKey(file, pageNo);
+  const std::uint64_t hash = mix(key);
+  PageTableGroup* group;
+  const PageTableSlot* slot = find(key, hash, group);
+  if (slot)
+    throw HashAlreadyPresentException(file->filename(), pageNo, slot->frameNo);
+
+  // only reached when more entries than frames are inserted, or deleted
+  // slots have piled up in a full table
+  if ((std::uint64_t)(numEntries + numDeleted + 1) * 8 > (std::uint64_t)numGroups * PageTableGroup::WIDTH * 7)
+    rehash(numEntries + 1);
+  insertUnique(key, hash, frameNo);
+}
+
+void PageTable::lookup(const File* file, const PageId pageNo, FrameId &frameNo) const
+{
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+bool PageTable::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) const
+{
+  const std::uint64_t key = packKey(file, pageNo);
+  PageTableGroup* group;
+  const PageTableSlot* slot = find(key, mix(key), group);
+  if (!slot)
+    return false;
+  frameNo = slot->frameNo; // return frameNo by reference
+  return true;
+}
+
+void PageTable::remove(const File* file, const PageId pageNo)
+{
+  const std::uint64_t key = packKey(file, pageNo);
+  PageTableGroup* group;
+  PageTableSlot* slot = find(key, mix(key), group);
+  if (!slot)
+    throw HashNotFoundException(file->filename(), pageNo);
+
+  // A group that still has an empty slot never sent a probe on to the next
+  // group, so the slot can become empty again; otherwise leave a tombstone.
+  const std::uint32_t i = slot - group->slots;
+  if (matchGroup(*group, CTRL_EMPTY)) {
+    group->ctrl[i] = CTRL_EMPTY;
+  } else {
+    group->ctrl[i] = CTRL_DELETED;
+    numDeleted++;
+  }
+  numEntries--;
+}
+
+}
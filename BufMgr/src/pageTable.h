@@ -0,0 +1,312 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "file.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace badgerdb {
+
+/**
+* @brief One entry of the page table
+*/
+struct PageTableSlot {
+	/**
+	 * Packed (file, page) key
+	 */
+	std::uint64_t key;
+
+	/**
+	 * Frame number of page in the buffer pool
+	 */
+	FrameId frameNo;
+};
+
+/**
+* @brief A group of slots probed together, stored next to their control bytes so the key compare after a
+* control byte match usually hits the same memory page (and often the same cache line) as the match.
+*/
+struct PageTableGroup {
+	/**
+	 * Number of slots in a group
+	 */
+#if defined(__AVX2__)
+	static const std::uint32_t WIDTH = 32;
+#else
+	static const std::uint32_t WIDTH = 16;
+#endif
+
+	/**
+	 * Control byte of every slot
+	 */
+	std::int8_t ctrl[WIDTH];
+
+	/**
+	 * Entries of the group
+	 */
+	PageTableSlot slots[WIDTH];
+};
+
+/**
+* @brief Open-addressing hash table mapping (File, page) to the frame holding it.
+*
+* Every (file, page) pair is packed into a 64-bit key and hashed with a full 64-bit mixer. Slots are split
+* into groups with one control byte per slot: the top bit marks an empty or deleted slot, the low 7 bits of
+* a full slot hold 7 bits of its key's hash. A lookup compares all control bytes of a group against those 7
+* bits in one SSE2 (or AVX2) instruction and only touches the keys of slots that match, so a probe rarely
+* reads more than one key. Insert and remove never allocate; the table is sized up front for the number of
+* frames and only rehashes if it is overfilled.
+*
+* @warning This class is not threadsafe.
+*/
+class PageTable
+{
+ private:
+	/**
+	 * Control byte of a slot that has never been used
+	 */
+  static const std::int8_t CTRL_EMPTY = -128;
+
+	/**
+	 * Control byte of a slot whose entry was removed
+	 */
+  static const std::int8_t CTRL_DELETED = -2;
+
+	/**
+	 * Number of slot groups, always a power of two
+	 */
+  std::uint32_t numGroups;
+
+	/**
+	 * Number of entries in the table
+	 */
+  std::uint32_t numEntries;
+
+	/**
+	 * Number of slots marked deleted
+	 */
+  std::uint32_t numDeleted;
+
+	/**
+	 * Slot groups
+	 */
+  PageTableGroup* groups;
+
+	/**
+	 * Returns a bit mask of the slots in group whose control byte equals value.
+	 *
+	 * @param group  	Group to match
+	 * @param value  	Control byte to look for
+	 * @return  			Bit i is set if slot i matches.
+	 */
+  static std::uint32_t matchGroup(const PageTableGroup& group, const std::int8_t value)
+	{
+#if defined(__AVX2__)
+		__m256i ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group.ctrl));
+		return (std::uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(value)));
+#elif defined(__SSE2__)
+		__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group.ctrl));
+		return (std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+		std::uint32_t mask = 0;
+		for(std::uint32_t i = 0; i < PageTableGroup::WIDTH; i++)
+			if(group.ctrl[i] == value)
+				mask |= 1u << i;
+		return mask;
+#endif
+	}
+
+	/**
+	 * Returns a bit mask of the slots in group that are empty or deleted.
+	 *
+	 * @param group  	Group to match
+	 * @return  			Bit i is set if slot i is free.
+	 */
+  static std::uint32_t matchFree(const PageTableGroup& group)
+	{
+#if defined(__AVX2__)
+		__m256i ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group.ctrl));
+		return (std::uint32_t)_mm256_movemask_epi8(ctrl);
+#elif defined(__SSE2__)
+		__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group.ctrl));
+		return (std::uint32_t)_mm_movemask_epi8(ctrl);
+#else
+		std::uint32_t mask = 0;
+		for(std::uint32_t i = 0; i < PageTableGroup::WIDTH; i++)
+			if(group.ctrl[i] < 0)
+				mask |= 1u << i;
+		return mask;
+#endif
+	}
+
+	/**
+	 * Returns the slot holding key, or NULL if it is not in the table. Inline since it is the whole hit path.
+	 *
+	 * @param key  		Packed key
+	 * @param hash  	Hash of the key
+	 * @param group  	Set to the group of the returned slot
+	 */
+  PageTableSlot* find(const std::uint64_t key, const std::uint64_t hash, PageTableGroup*& group) const
+	{
+		const std::int8_t h2 = hash & 0x7F;
+		const std::uint32_t groupMask = numGroups - 1;
+		std::uint32_t index = (hash >> 7) & groupMask;
+		//triangular probing visits every group exactly once
+		for(std::uint32_t step = 1; step <= numGroups; step++)
+		{
+			group = &groups[index];
+			std::uint32_t candidates = matchGroup(*group, h2);
+			while(candidates)
+			{
+				PageTableSlot* slot = &group->slots[__builtin_ctz(candidates)];
+				if(slot->key == key)
+					return slot;
+				candidates &= candidates - 1;
+			}
+			//an empty slot ends every probe sequence that reached this group
+			if(matchGroup(*group, CTRL_EMPTY))
+				return NULL;
+			index = (index + step) & groupMask;
+		}
+		return NULL;
+	}
+
+	/**
+	 * Inserts a key known not to be in the table.
+	 *
+	 * @param key  		Packed key
+	 * @param hash  	Hash of the key
+	 * @param frameNo	Frame number to map the key to
+	 */
+  void insertUnique(const std::uint64_t key, const std::uint64_t hash, const FrameId frameNo);
+
+	/**
+	 * Rebuilds the table with room for at least minEntries entries, dropping all deleted slots. A table
+	 * already large enough keeps its size and storage.
+	 *
+	 * @param minEntries	Number of entries the new table must hold
+	 */
+  void rehash(const std::uint32_t minEntries);
+
+	/**
+	 * Allocates empty storage for the given number of groups.
+	 *
+	 * @param count		Number of groups, a power of two
+	 */
+  void allocate(const std::uint32_t count);
+
+ public:
+	/**
+	 * Packs a (file, page) pair into one 64-bit key.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Packed key.
+	 */
+  static std::uint64_t packKey(const File* file, const PageId pageNo)
+	{
+		return ((std::uint64_t)file->id() << 32) | pageNo;
+	}
+
+	/**
+	 * returns the 64-bit hash of (file, pageNo). The low 7 bits are stored in the control bytes and the bits
+	 * above pick the first group probed; the buffer manager picks partitions from the top bits.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Hash value.
+	 */
+  static std::uint64_t hashKey(const File* file, const PageId pageNo)
+	{
+		return mix(packKey(file, pageNo));
+	}
+
+	/**
+	 * Finalizer of MurmurHash3, so every key bit affects every hash bit.
+	 *
+	 * @param key  		Value to hash
+	 * @return  			Hash value.
+	 */
+  static std::uint64_t mix(std::uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+
+	/**
+   * Constructor of PageTable class
+	 *
+	 * @param maxEntries	Number of entries the table can hold without rehashing
+	 */
+	PageTable(const std::uint32_t maxEntries);
+
+	/**
+   * Destructor of PageTable class
+	 */
+  ~PageTable();
+
+	/**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @param frameNo Frame number assigned to that page of the file
+   * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
+	 */
+  void insert(const File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table).
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference
+   * @throws HashNotFoundException if the page entry is not found in the hash table
+	 */
+  void lookup(const File* file, const PageId pageNo, FrameId &frameNo) const;
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool without throwing on a miss.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the page is found
+	 * @return 				True if the page entry is in the hash table
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) const;
+
+	/**
+   * Delete entry (file,pageNo) from hash table.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+   * @throws HashNotFoundException if the page entry is not found in the hash table
+	 */
+  void remove(const File* file, const PageId pageNo);
+
+	/**
+   * Returns the number of entries in the table
+	 */
+  std::uint32_t size() const
+	{
+		return numEntries;
+	}
+};
+
+}
@@ -0,0 +1,129 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Interface deciding which buffer pool frame is given up when a new page has to be read in.
+*
+* The buffer manager reports every pin, unpin, load and eviction of a frame to the policy, and asks it for
+* victims when it needs a frame. A victim only becomes free once the buffer manager manages to claim it, so
+* the policy may be asked again after proposing a frame that got pinned in the meantime.
+*
+* Hooks are called concurrently from many threads; implementations synchronize their own state. They must
+* not call back into the buffer manager.
+*/
+class ReplacementPolicy
+{
+ public:
+	/**
+	 * Predicate telling whether a frame could be evicted right now, i.e. is not pinned. A plain function and
+	 * its argument rather than a std::function, so a sweep asking about every frame calls it directly.
+	 */
+  struct EvictablePredicate
+	{
+		/**
+	   * Returns true if the frame is evictable
+		 */
+	  bool (*test)(const void* context, const FrameId frameNo);
+
+		/**
+	   * First argument of test
+		 */
+	  const void* context;
+
+		/**
+	   * Returns true if the frame is evictable
+		 */
+	  bool operator()(const FrameId frameNo) const
+		{
+			return test(context, frameNo);
+		}
+	};
+
+	/**
+   * Destructor of ReplacementPolicy class
+	 */
+  virtual ~ReplacementPolicy() {}
+
+	/**
+	 * The buffer manager hands the policy the FrameState words of its frames, before calling any other hook.
+	 * A policy may keep a per-frame counter in the bits FrameState::USAGE_MASK reserves, next to the pin
+	 * count its sweep reads anyway. The default ignores them.
+	 *
+	 * @param states	FrameState word of every frame, indexed by frame number
+	 */
+  virtual void attachFrameStates(std::atomic<std::uint64_t>* states) {}
+
+	/**
+	 * A page already in frameNo was pinned again.
+	 *
+	 * @param frameNo	Frame holding the page
+	 */
+  virtual void recordAccess(const FrameId frameNo) = 0;
+
+	/**
+	 * A page was read or allocated into frameNo and pinned for the first time.
+	 *
+	 * @param frameNo	Frame holding the page
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  virtual void recordLoad(const FrameId frameNo, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * One pin on the page in frameNo was dropped.
+	 *
+	 * @param frameNo	Frame holding the page
+	 */
+  virtual void recordUnpin(const FrameId frameNo) = 0;
+
+	/**
+	 * The page in frameNo was evicted to make room for another page.
+	 *
+	 * @param frameNo	Frame that held the page
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  virtual void recordEviction(const FrameId frameNo, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * frameNo became empty for any other reason than an eviction (the page was flushed or disposed, or a
+	 * reserved frame was handed back).
+	 *
+	 * @param frameNo	Frame that is now empty
+	 */
+  virtual void recordFree(const FrameId frameNo) = 0;
+
+	/**
+	 * Proposes the frame to evict next.
+	 *
+	 * @param frameNo		Proposed frame, returned via this reference
+	 * @param evictable	Tells whether a frame is currently unpinned
+	 * @return 					False if no frame is evictable
+	 */
+  virtual bool pickVictim(FrameId& frameNo, const EvictablePredicate& evictable) = 0;
+
+	/**
+	 * Lists frames the policy expects to pick as victims soon, best first, without changing any state. The
+	 * background cleaner writes their pages back before a miss has to.
+	 *
+	 * @param frames	Receives up to count frame numbers, pinned ones included
+	 * @param count		Number of frames to look ahead
+	 */
+  virtual void upcomingVictims(std::vector<FrameId>& frames, const std::uint32_t count) = 0;
+};
+
+}